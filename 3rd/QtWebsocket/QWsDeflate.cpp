@@ -0,0 +1,284 @@
+/*
+Copyright 2013 Antoine Lafarge qtwebsocket@gmail.com
+
+This file is part of QtWebsocket.
+
+QtWebsocket is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+any later version.
+
+QtWebsocket is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QtWebsocket.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "QWsDeflate.h"
+
+#include <cstring>
+
+#include <QStringList>
+
+namespace QtWebsocket
+{
+
+// ends every sync flushed block, left out on the wire
+static const char syncFlushTail[4] = { 0x00, 0x00, (char)0xFF, (char)0xFF };
+
+QWsDeflateOptions::QWsDeflateOptions() :
+	enabled(false),
+	threshold(256),
+	level(Z_DEFAULT_COMPRESSION),
+	serverNoContextTakeover(false),
+	clientNoContextTakeover(false),
+	maxInflatedBytes(1 << 20)
+{}
+
+QWsDeflateParams::QWsDeflateParams() :
+	serverNoContextTakeover(false),
+	clientNoContextTakeover(false),
+	serverMaxWindowBits(MAX_WBITS)
+{}
+
+QWsDeflate::QWsDeflate(const QWsDeflateOptions& options, const QWsDeflateParams& params) :
+	options(options),
+	params(params),
+	valid(false)
+{
+	memset(&deflater, 0, sizeof(deflater));
+	memset(&inflater, 0, sizeof(inflater));
+
+	// negative window bits for raw deflate data without zlib header
+	bool deflateReady = deflateInit2(&deflater, options.level, Z_DEFLATED, -params.serverMaxWindowBits, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+	bool inflateReady = inflateInit2(&inflater, -MAX_WBITS) == Z_OK;
+	valid = deflateReady && inflateReady;
+}
+
+QWsDeflate::~QWsDeflate()
+{
+	deflateEnd(&deflater);
+	inflateEnd(&inflater);
+}
+
+int QWsDeflate::threshold() const
+{
+	return options.threshold;
+}
+
+bool QWsDeflate::compress(const char* data, int size, QByteArray& output)
+{
+	if (!valid)
+	{
+		return false;
+	}
+
+	deflater.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+	deflater.avail_in = size;
+
+	int outputSize = 0;
+	output.resize(deflateBound(&deflater, size) + 16);
+	do
+	{
+		if (outputSize == output.size())
+		{
+			output.resize(output.size() * 2);
+		}
+		deflater.next_out = reinterpret_cast<Bytef*>(output.data() + outputSize);
+		deflater.avail_out = output.size() - outputSize;
+		if (deflate(&deflater, Z_SYNC_FLUSH) == Z_STREAM_ERROR)
+		{
+			return false;
+		}
+		outputSize = output.size() - deflater.avail_out;
+	} while (deflater.avail_out == 0);
+
+	if (outputSize >= 4 && memcmp(output.constData() + outputSize - 4, syncFlushTail, 4) == 0)
+	{
+		outputSize -= 4;
+	}
+
+	// nothing was flushed for an empty message, a lone empty stored block
+	// header completes the tail the receiver appends
+	if (outputSize == 0)
+	{
+		output.resize(1);
+		output.data()[0] = 0x00;
+		outputSize = 1;
+	}
+	output.resize(outputSize);
+
+	if (params.serverNoContextTakeover)
+	{
+		deflateReset(&deflater);
+	}
+	return true;
+}
+
+bool QWsDeflate::decompress(const char* data, int size, QByteArray& output)
+{
+	if (!valid)
+	{
+		return false;
+	}
+
+	int outputSize = 0;
+	bool streamEnd = false;
+	// a guess at the ratio, never more than a message may inflate to
+	qint64 initialSize = qMax((qint64)size * 4, (qint64)256);
+	output.resize((int)qMin(initialSize, (qint64)options.maxInflatedBytes));
+
+	bool ok = inflateInput(data, size, output, outputSize, streamEnd);
+	if (ok && !streamEnd)
+	{
+		ok = inflateInput(syncFlushTail, 4, output, outputSize, streamEnd);
+	}
+	output.resize(outputSize);
+
+	// a final block ends the stream, the next message starts a new one
+	if (!ok || streamEnd || params.clientNoContextTakeover)
+	{
+		inflateReset(&inflater);
+	}
+	return ok;
+}
+
+bool QWsDeflate::inflateInput(const char* data, int size, QByteArray& output, int& outputSize, bool& streamEnd)
+{
+	inflater.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+	inflater.avail_in = size;
+
+	while (true)
+	{
+		if (outputSize == output.size())
+		{
+			if (output.size() >= options.maxInflatedBytes)
+			{
+				return false;
+			}
+			output.resize((int)qMin((qint64)output.size() * 2, (qint64)options.maxInflatedBytes));
+		}
+		inflater.next_out = reinterpret_cast<Bytef*>(output.data() + outputSize);
+		inflater.avail_out = output.size() - outputSize;
+
+		int result = inflate(&inflater, Z_SYNC_FLUSH);
+		outputSize = output.size() - inflater.avail_out;
+
+		if (result == Z_STREAM_END)
+		{
+			streamEnd = true;
+			return true;
+		}
+		if (result == Z_BUF_ERROR && inflater.avail_in == 0)
+		{
+			return true;
+		}
+		if (result != Z_OK && result != Z_BUF_ERROR)
+		{
+			return false;
+		}
+		// the output filled up or the input ran out
+		if (inflater.avail_in == 0 && inflater.avail_out != 0)
+		{
+			return true;
+		}
+	}
+}
+
+bool QWsDeflate::negotiate(const QString& offers, const QWsDeflateOptions& options, QWsDeflateParams& params, QString& response)
+{
+	if (!options.enabled)
+	{
+		return false;
+	}
+
+	QStringList offerList = offers.split(QLatin1Char(','));
+	for (int o=0 ; o<offerList.size() ; o++)
+	{
+		QStringList parts = offerList[o].split(QLatin1Char(';'));
+		if (parts.first().trimmed() != QLatin1String("permessage-deflate"))
+		{
+			continue;
+		}
+
+		QWsDeflateParams offered;
+		bool serverMaxWindowBitsOffered = false;
+		bool acceptable = true;
+		QStringList seen;
+
+		for (int i=1 ; i<parts.size() && acceptable ; i++)
+		{
+			QString name = parts[i].section(QLatin1Char('='), 0, 0).trimmed();
+			QString value = parts[i].section(QLatin1Char('='), 1).trimmed().remove(QLatin1Char('"'));
+			bool hasValue = parts[i].contains(QLatin1Char('='));
+
+			// parameters may not repeat within an offer
+			if (seen.contains(name))
+			{
+				acceptable = false;
+				break;
+			}
+			seen << name;
+
+			if (name == QLatin1String("server_no_context_takeover") && !hasValue)
+			{
+				offered.serverNoContextTakeover = true;
+			}
+			else if (name == QLatin1String("client_no_context_takeover") && !hasValue)
+			{
+				offered.clientNoContextTakeover = true;
+			}
+			else if (name == QLatin1String("server_max_window_bits") && hasValue)
+			{
+				// zlib can't deflate with a 256 byte window
+				bool isNumber = false;
+				int bits = value.toInt(&isNumber);
+				acceptable = isNumber && bits >= 9 && bits <= MAX_WBITS;
+				offered.serverMaxWindowBits = bits;
+				serverMaxWindowBitsOffered = true;
+			}
+			else if (name == QLatin1String("client_max_window_bits"))
+			{
+				// the inflater takes any window, nothing to limit
+				bool isNumber = false;
+				int bits = value.toInt(&isNumber);
+				acceptable = !hasValue || (isNumber && bits >= 8 && bits <= MAX_WBITS);
+			}
+			else
+			{
+				acceptable = false;
+			}
+		}
+
+		if (!acceptable)
+		{
+			continue;
+		}
+
+		params = offered;
+		params.serverNoContextTakeover |= options.serverNoContextTakeover;
+		params.clientNoContextTakeover |= options.clientNoContextTakeover;
+
+		response = QLatin1String("permessage-deflate");
+		if (params.serverNoContextTakeover)
+		{
+			response += QLatin1String("; server_no_context_takeover");
+		}
+		if (params.clientNoContextTakeover)
+		{
+			response += QLatin1String("; client_no_context_takeover");
+		}
+		if (serverMaxWindowBitsOffered)
+		{
+			response += QString("; server_max_window_bits=%1").arg(params.serverMaxWindowBits);
+		}
+		return true;
+	}
+
+	return false;
+}
+
+} // namespace QtWebsocket
@@ -0,0 +1,123 @@
+/*
+Copyright 2013 Antoine Lafarge qtwebsocket@gmail.com
+
+This file is part of QtWebsocket.
+
+QtWebsocket is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+any later version.
+
+QtWebsocket is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QtWebsocket.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef QWSDEFLATE_H
+#define QWSDEFLATE_H
+
+#include <QByteArray>
+#include <QString>
+
+#include <zlib.h>
+
+namespace QtWebsocket
+{
+
+/*!
+ * Server side settings of the permessage-deflate extension.
+ *
+ * See also [RFC 7692](http://tools.ietf.org/html/rfc7692).
+ */
+struct QWsDeflateOptions
+{
+	QWsDeflateOptions();
+
+	bool enabled;
+
+	/*!
+	 * Messages shorter than this are sent uncompressed.
+	 */
+	int threshold;
+
+	/*!
+	 * zlib compression level, 1 to 9.
+	 */
+	int level;
+
+	/*!
+	 * Start every message with an empty window. Compresses worse but keeps no
+	 * window memory between messages.
+	 */
+	bool serverNoContextTakeover;
+	bool clientNoContextTakeover;
+
+	/*!
+	 * Larger inflated messages close the connection.
+	 */
+	int maxInflatedBytes;
+};
+
+/*!
+ * Parameters both ends agreed on in the handshake.
+ */
+struct QWsDeflateParams
+{
+	QWsDeflateParams();
+
+	bool serverNoContextTakeover;
+	bool clientNoContextTakeover;
+	int serverMaxWindowBits;
+};
+
+/*!
+ * Compression state of one server side connection that negotiated
+ * permessage-deflate.
+ */
+class QWsDeflate
+{
+public:
+	QWsDeflate(const QWsDeflateOptions& options, const QWsDeflateParams& params);
+	~QWsDeflate();
+
+	int threshold() const;
+
+	/*!
+	 * Compresses a whole message into `output`, without the trailing
+	 * 0x00 0x00 0xff 0xff of the sync flush.
+	 */
+	bool compress(const char* data, int size, QByteArray& output);
+
+	/*!
+	 * Inflates a whole received message into `output`. Fails on corrupt data
+	 * and on messages over `maxInflatedBytes`.
+	 */
+	bool decompress(const char* data, int size, QByteArray& output);
+
+	/*!
+	 * Picks the first acceptable permessage-deflate offer from the client's
+	 * Sec-WebSocket-Extensions header.
+	 *
+	 * Returns false if none is acceptable, `response` otherwise holds the
+	 * value of the Sec-WebSocket-Extensions response header.
+	 */
+	static bool negotiate(const QString& offers, const QWsDeflateOptions& options, QWsDeflateParams& params, QString& response);
+
+private:
+	bool inflateInput(const char* data, int size, QByteArray& output, int& outputSize, bool& streamEnd);
+
+	QWsDeflateOptions options;
+	QWsDeflateParams params;
+
+	z_stream deflater;
+	z_stream inflater;
+	bool valid;
+};
+
+} // namespace QtWebsocket
+
+#endif // QWSDEFLATE_H
@@ -41,11 +41,9 @@ void QWsFrame::clear()
 
 QByteArray QWsFrame::data() const
 {
-	QByteArray result;
-	result.reserve(payload.size());
 	if (hasMask) {
-		for (int i=0 ; i<payload.size() ; i++)
-			result[i] = (payload[i] ^ maskingKey[i % 4]);
+		QByteArray result(payload);
+		QWsSocket::maskInPlace(result.data(), result.size(), maskingKey);
 		return result;
 	}
 	else
@@ -58,6 +58,16 @@ void QWsServer::close()
 	tcpServer->close();
 }
 
+void QWsServer::setDeflateOptions(const QWsDeflateOptions& options)
+{
+	deflateOpts = options;
+}
+
+QWsDeflateOptions QWsServer::deflateOptions()
+{
+	return deflateOpts;
+}
+
 Protocol QWsServer::allowedProtocols()
 {
 	return tlsServer.allowedProtocols();
@@ -169,11 +179,15 @@ void QWsServer::dataReceived()
 
 	// Compose opening handshake response
 	QByteArray handshakeResponse;
+	QString extensions;
+	bool deflateAgreed = false;
+	QWsDeflateParams deflateParams;
 
 	if (handshake.version >= WS_V6)
 	{
 		QByteArray accept = QWsSocket::computeAcceptV4(handshake.key);
-		handshakeResponse = QWsServer::composeOpeningHandshakeResponseV6(accept, handshake.protocol).toUtf8();
+		deflateAgreed = QWsDeflate::negotiate(handshake.extensions, deflateOpts, deflateParams, extensions);
+		handshakeResponse = QWsServer::composeOpeningHandshakeResponseV6(accept, handshake.protocol, extensions).toUtf8();
 	}
 	else if (handshake.version >= WS_V4)
 	{
@@ -199,8 +213,12 @@ void QWsServer::dataReceived()
 	wsSocket->setHostPort(handshake.hostPort.toUInt());
 	wsSocket->setOrigin(handshake.origin);
 	wsSocket->setProtocol(handshake.protocol);
-	wsSocket->setExtensions(handshake.extensions);
+	wsSocket->setExtensions(extensions);
 	wsSocket->_wsMode = WsServerMode;
+	if (deflateAgreed)
+	{
+		wsSocket->_deflate = new QWsDeflate(deflateOpts, deflateParams);
+	}
 	
 	QWsHandshake* hsTmp = handshakeBuffer.take(tcpSocket);
 	delete hsTmp;
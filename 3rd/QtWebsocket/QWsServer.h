@@ -69,6 +69,9 @@ public:
 	int socketDescriptor();
 	bool waitForNewConnection(int msec = 0, bool* timedOut = 0);
 	Protocol allowedProtocols();
+	// permessage-deflate for connections accepted from now on
+	void setDeflateOptions(const QWsDeflateOptions& options);
+	QWsDeflateOptions deflateOptions();
 
 signals:
 	void newConnection();
@@ -92,6 +95,7 @@ private:
 	QTlsServer tlsServer;
 	QQueue<QWsSocket*> pendingConnections;
 	QHash<const QTcpSocket*, QWsHandshake*> handshakeBuffer;
+	QWsDeflateOptions deflateOpts;
 
 	bool useSsl;
 	QSslKey sslKey;
@@ -26,8 +26,19 @@ along with QtWebsocket.  If not, see <http://www.gnu.org/licenses/>.
 #include <QFile>
 #include <QtCore/qmath.h>
 
+#include <climits>
+#include <cstring>
 #include <iostream>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef Q_OS_LINUX
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
 #include "QWsServer.h"
 #include "QWsFrame.h"
 #include "functions.h"
@@ -51,19 +62,31 @@ QWsSocket::QWsSocket(QObject* parent, QTcpSocket* socket, EWebsocketVersion ws_v
 	tcpSocket(socket ? socket : new QTcpSocket),
 	_wsMode(WsClientMode),
 	_currentFrame(new QWsFrame),
+	_deflate(NULL),
+	currentDataCompressed(false),
 	continuation(false),
+	receiveOffset(0),
+	_maxMessageSize(defaultMaxMessageSize),
 	_version(ws_v),
 	_hostPort(-1),
 	closingHandshakeSent(false),
 	closingHandshakeReceived(false),
-	_secured(false)
+	_secured(false),
+	corked(false),
+	_corkThreshold(defaultCorkThreshold),
+	corkedTailOwned(false),
+	corkedBytes(0),
+	queuedBytes(0)
 {
+	// reserved so emptying the buffer between reads keeps its memory
+	receiveBuffer.reserve(receiveBufferReserve);
 	initTcpSocket();
 }
 
 QWsSocket::~QWsSocket()
 {
 	delete _currentFrame;
+	delete _deflate;
 
 	QAbstractSocket::SocketState state = QAbstractSocket::state();
 	if (state != QAbstractSocket::UnconnectedState)
@@ -229,6 +252,9 @@ void QWsSocket::close(CloseStatusCode closeStatusCode, QString reason)
 		return;
 	}
 
+	// queued frames go out before the close frame
+	flushFrames();
+
 	if (! closingHandshakeSent)
 	{
 		switch (_version)
@@ -323,11 +349,36 @@ qint64 QWsSocket::write(const QString& string)
 	}
 }
 
+qint64 QWsSocket::writeText(const QByteArray& utf8)
+{
+	return QWsSocket::internalWrite(utf8, false);
+}
+
 qint64 QWsSocket::write(const QByteArray& byteArray)
 {
 	return QWsSocket::internalWrite(byteArray, true);
 }
 
+qint64 QWsSocket::writeSharedFrames(const QByteArray& frames, const QByteArray& data, bool asBinary)
+{
+	// clients mask every frame and hixie-76 frames differently
+	if (_wsMode != WsServerMode || _version == WS_V0)
+	{
+		return QWsSocket::internalWrite(data, asBinary);
+	}
+
+	if (writeFrame(frames, true) != -1)
+	{
+		markMessageEnd();
+		emit bytesWritten(data.size());
+		return data.size();
+	}
+	else
+	{
+		return -1;
+	}
+}
+
 qint64 QWsSocket::internalWrite(const QByteArray& byteArray, bool asBinary)
 {
 	if (_version == WS_V0)
@@ -336,7 +387,9 @@ qint64 QWsSocket::internalWrite(const QByteArray& byteArray, bool asBinary)
 		BA.append((char)0x00);
 		BA.append(byteArray);
 		BA.append((char)0xFF);
-		return writeFrame(BA);
+		qint64 written = writeFrame(BA);
+		markMessageEnd();
+		return written;
 	}
 	
 	QByteArray maskingKey;
@@ -353,10 +406,21 @@ qint64 QWsSocket::internalWrite(const QByteArray& byteArray, bool asBinary)
 	}
 	
 	Opcode opcode = (asBinary ? OpBinary : OpText);
-	const QList<QByteArray>& framesList = QWsSocket::composeFrames(byteArray, opcode, maskingKey, maxBytesPerFrame);
+	QList<QByteArray> framesList;
+	if (_deflate && byteArray.size() >= _deflate->threshold() && _deflate->compress(byteArray.constData(), byteArray.size(), deflatedData))
+	{
+		// RSV1 of the first frame marks the message as compressed
+		framesList = QWsSocket::composeFrames(deflatedData, opcode, maskingKey, maxBytesPerFrame);
+		framesList[0][0] = (char)(framesList[0][0] | 0x40);
+	}
+	else
+	{
+		framesList = QWsSocket::composeFrames(byteArray, opcode, maskingKey, maxBytesPerFrame);
+	}
 
 	if(writeFrames(framesList) != -1)
 	{
+		markMessageEnd();
 		emit bytesWritten(byteArray.size());
 		return byteArray.size();
 	}
@@ -471,6 +535,10 @@ void QWsSocket::processDataV0()
 
 	if (currentFrame.size() > 0)
 	{
+		if (isValidUtf8(currentFrame.constData(), currentFrame.size()))
+		{
+			emit textFrameReceived(currentFrame);
+		}
 		emit frameReceived(QString::fromUtf8(currentFrame));
 		currentFrame.clear();
 	}
@@ -489,162 +557,188 @@ void QWsSocket::processDataV4()
 		return;
 	}
 
+	// everything available goes to the end of the receive buffer in one read
+	qint64 available = tcpSocket->bytesAvailable();
+	if (available > 0)
+	{
+		int size = receiveBuffer.size();
+		receiveBuffer.resize(size + available);
+		qint64 bytesRead = tcpSocket->read(receiveBuffer.data() + size, available);
+		receiveBuffer.resize(size + qMax(bytesRead, (qint64)0));
+	}
+
+	// frames are parsed and unmasked where they lie in the buffer,
+	// an incomplete one waits there for the rest of its bytes
 	while (true)
 	{
-		switch (_currentFrame->readingState)
+		const int remaining = receiveBuffer.size() - receiveOffset;
+		if (remaining < 2)
 		{
-			case HeaderPending:
-			{
-				if (tcpSocket->bytesAvailable() < 2)
-				{
-					return;
-				}
+			break;
+		}
 
-				// FIN, RSV1-3, Opcode
-				char header[2];
-				tcpSocket->read(header, 2); // XXX: Handle return value
-				_currentFrame->final = (header[0] & 0x80) != 0;
-				_currentFrame->rsv = header[0] & 0x70;
-				_currentFrame->opcode = static_cast<Opcode>(header[0] & 0x0F);
-
-				// Mask, PayloadLength
-				_currentFrame->hasMask = (header[1] & 0x80) != 0;
-				_currentFrame->payloadLength = header[1] & 0x7F;
-				switch (_currentFrame->payloadLength)
-				{
-					case 126:
-						_currentFrame->readingState = PayloadLengthPending;
-						break;
-					case 127:
-						_currentFrame->readingState = BigPayloadLenghPending;
-						break;
-					default:
-						_currentFrame->readingState = MaskPending;
-						break;
-				}
-				break;
-			};
-			case PayloadLengthPending:
-			{
-				if (tcpSocket->bytesAvailable() < 2)
-				{
-					return;
-				}
+		uchar* frame = reinterpret_cast<uchar*>(receiveBuffer.data()) + receiveOffset;
+
+		// FIN, RSV1-3, Opcode
+		_currentFrame->final = (frame[0] & 0x80) != 0;
+		_currentFrame->rsv = frame[0] & 0x70;
+		_currentFrame->opcode = static_cast<Opcode>(frame[0] & 0x0F);
 
-				quint16 length;
-				tcpSocket->read((char*)&length, 2); // XXX: Handle return value
-				_currentFrame->payloadLength = qFromBigEndian(length);
-				_currentFrame->readingState = MaskPending;
+		// Mask, PayloadLength
+		_currentFrame->hasMask = (frame[1] & 0x80) != 0;
+		_currentFrame->payloadLength = frame[1] & 0x7F;
+
+		int headerSize = 2;
+		if (_currentFrame->payloadLength == 126)
+		{
+			headerSize += 2;
+			if (remaining < headerSize)
+			{
 				break;
-			};
-			case BigPayloadLenghPending:
+			}
+			_currentFrame->payloadLength = qFromBigEndian<quint16>(frame + 2);
+		}
+		else if (_currentFrame->payloadLength == 127)
+		{
+			headerSize += 8;
+			if (remaining < headerSize)
 			{
-				if (tcpSocket->bytesAvailable() < 8)
-				{
-					return;
-				}
+				break;
+			}
+			// Most significant bit must be set to 0 as per http://tools.ietf.org/html/rfc6455#section-5.2
+			// checked by QWsFrame::valid()
+			_currentFrame->payloadLength = qFromBigEndian<quint64>(frame + 2);
+		}
 
-				quint64 length;
-				tcpSocket->read((char*)&length, 8); // XXX: Handle return value
-				// Most significant bit must be set to 0 as per http://tools.ietf.org/html/rfc6455#section-5.2
-				// XXX: Check for that?
-				_currentFrame->payloadLength = qFromBigEndian(length);
-				_currentFrame->readingState = MaskPending;
+		if (_currentFrame->hasMask)
+		{
+			if (remaining < headerSize + 4)
+			{
 				break;
-			};
-			case MaskPending:
+			}
+			memcpy(_currentFrame->maskingKey, frame + headerSize, 4);
+			headerSize += 4;
+		}
+
+		// RSV1 marks the first frame of a compressed message
+		bool compressed = false;
+		if (_deflate && (_currentFrame->rsv & 0x40) && !_currentFrame->controlFrame() && _currentFrame->opcode != OpContinue)
+		{
+			compressed = true;
+			_currentFrame->rsv &= ~0x40;
+		}
+
+		currentOpcode = _currentFrame->opcode;
+		if (!_currentFrame->valid())
+		{
+			if (currentOpcode == OpClose)
 			{
-				if (!_currentFrame->hasMask)
-				{
-					_currentFrame->readingState = PayloadBodyPending;
-					break;
-				}
+				closingHandshakeReceived = true;
+			}
+			discardReceived();
+			close(CloseProtocolError);
+			return;
+		}
 
-				if (tcpSocket->bytesAvailable() < 4)
-				{
-					return;
-				}
+		// the whole frame has to fit in the buffer, and a message, counting
+		// the fragments received so far, is refused before it is buffered
+		if (_currentFrame->payloadLength > INT_MAX - headerSize
+			|| (!_currentFrame->controlFrame()
+				&& (quint64)currentData.size() + _currentFrame->payloadLength > (quint64)_maxMessageSize))
+		{
+			discardReceived();
+			close(CloseTooMuchData);
+			return;
+		}
 
-				tcpSocket->read(_currentFrame->maskingKey, 4); // XXX: Handle return value
+		if (remaining - headerSize < _currentFrame->payloadLength)
+		{
+			break;
+		}
 
-				/*if (opcode == OpClose)
-				{
-					_currentFrame->readingState = CloseDataPending;
-				}
-				else
-				{*/
-					_currentFrame->readingState = PayloadBodyPending;
-				//}
-				//break; //// Intentional fall-through ////
-			};
-			case PayloadBodyPending:
-			{
-				// TODO: Handle large payloads
-				if (tcpSocket->bytesAvailable() < _currentFrame->payloadLength)
-				{
-					return;
-				}
+		char* payload = reinterpret_cast<char*>(frame) + headerSize;
+		const int payloadSize = (int)_currentFrame->payloadLength;
+		receiveOffset += headerSize + payloadSize;
 
-				_currentFrame->payload = tcpSocket->read(_currentFrame->payloadLength);
-				currentFrame.append(_currentFrame->data());
+		if (_currentFrame->hasMask)
+		{
+			QWsSocket::maskInPlace(payload, payloadSize, _currentFrame->maskingKey);
+		}
 
-				currentOpcode = _currentFrame->opcode;
-				if (!_currentFrame->valid())
-				{
-					_currentFrame->clear();
-					if (currentOpcode == OpClose)
-					{
-						closingHandshakeReceived = true;
-					}
-					close(CloseProtocolError);
-					continue;
-				}
+		if (_currentFrame->controlFrame())
+		{
+			handleControlFrame(QByteArray::fromRawData(payload, payloadSize));
+			continue;
+		}
 
-				if (_currentFrame->controlFrame())
-				{
-					handleControlFrame();
-				}
-				else
-				{
-					if (currentOpcode != OpContinue)
-					{
-						currentDataOpcode = _currentFrame->opcode;
-					}
+		if (currentOpcode != OpContinue)
+		{
+			currentDataOpcode = _currentFrame->opcode;
+			currentDataCompressed = compressed;
+		}
 
-					if ((currentOpcode == OpContinue && !continuation) || (currentOpcode != OpContinue && continuation))
-					{
-						_currentFrame->clear();
-						close(CloseProtocolError);
-						continue;
-					}
+		if ((currentOpcode == OpContinue && !continuation) || (currentOpcode != OpContinue && continuation))
+		{
+			discardReceived();
+			close(CloseProtocolError);
+			return;
+		}
 
-					continuation = !_currentFrame->final;
-					currentData.append(_currentFrame->data());
+		continuation = !_currentFrame->final;
 
-					if (_currentFrame->final)
-					{
-						handleData();
-					}
-				}
+		if (!_currentFrame->final)
+		{
+			currentData.append(payload, payloadSize);
+			continue;
+		}
 
-				_currentFrame->clear();
-				break;
-			};
-			case CloseDataPending:
-				// TODO
-				break;
-			default:
-				break;
-		} // end switch
-	} // end while(1)
+		// unfragmented messages are handed over straight from the buffer
+		const char* message = payload;
+		int messageSize = payloadSize;
+		if (!currentData.isEmpty())
+		{
+			currentData.append(payload, payloadSize);
+			message = currentData.constData();
+			messageSize = currentData.size();
+		}
 
-	if (tcpSocket->bytesAvailable())
+		if (currentDataCompressed)
+		{
+			if (!_deflate->decompress(message, messageSize, inflatedData))
+			{
+				discardReceived();
+				close(CloseTooMuchData);
+				return;
+			}
+			message = inflatedData.constData();
+			messageSize = inflatedData.size();
+		}
+
+		handleData(message, messageSize);
+		currentData.clear();
+	}
+
+	// the unparsed tail moves to the front, the capacity stays
+	if (receiveOffset == receiveBuffer.size())
 	{
-		processDataV4();
+		receiveBuffer.resize(0);
 	}
+	else if (receiveOffset > 0)
+	{
+		receiveBuffer.remove(0, receiveOffset);
+	}
+	receiveOffset = 0;
+}
+
+void QWsSocket::discardReceived()
+{
+	receiveBuffer.resize(0);
+	receiveOffset = 0;
+	currentData.clear();
+	continuation = false;
 }
 
-void QWsSocket::handleData()
+void QWsSocket::handleData(const char* data, int size)
 {
 	if (state() == ClosingState)
 	{
@@ -652,19 +746,28 @@ void QWsSocket::handleData()
 	}
 	if (currentDataOpcode == OpBinary)
 	{
-		emit frameReceived(currentData);
-		currentData.clear();
+		emit frameReceived(QByteArray::fromRawData(data, size));
 		return;
 	}
 	if (currentDataOpcode == OpText)
 	{
-		emit frameReceived(QString::fromUtf8(currentData));
-		currentData.clear();
+		// validated once here, receivers of the bytes can trust them
+		if (!isValidUtf8(data, size))
+		{
+			close(CloseWrongDataType);
+			return;
+		}
+		emit textFrameReceived(QByteArray::fromRawData(data, size));
+		// decoded only for whoever still wants a QString
+		if (receivers(SIGNAL(frameReceived(QString))) > 0)
+		{
+			emit frameReceived(QString::fromUtf8(data, size));
+		}
 		return;
 	}
 }
 
-void QWsSocket::handleControlFrame()
+void QWsSocket::handleControlFrame(const QByteArray& payload)
 {
 	if (currentOpcode == OpClose)
 	{
@@ -678,7 +781,7 @@ void QWsSocket::handleControlFrame()
 	}
 	if (currentOpcode == OpPing)
 	{
-		handlePing(_currentFrame->data());
+		handlePing(payload);
 		return;
 	}
 	if (currentOpcode == OpPong)
@@ -688,11 +791,190 @@ void QWsSocket::handleControlFrame()
 	}
 }
 
-qint64 QWsSocket::writeFrame(const QByteArray& byteArray)
+qint64 QWsSocket::writeFrame(const QByteArray& byteArray, bool shared)
 {
+	queuedBytes += byteArray.size();
+	if (corked)
+	{
+		if (shared)
+		{
+			// a reference, the frame is the same for every socket
+			corkedFrames.append(byteArray);
+			corkedTailOwned = false;
+		}
+		else if (corkedTailOwned)
+		{
+			corkedFrames.last().append(byteArray);
+		}
+		else
+		{
+			// detached by the first frame appended to it
+			corkedFrames.append(byteArray);
+			corkedTailOwned = true;
+		}
+		corkedBytes += byteArray.size();
+		if (corkedBytes >= _corkThreshold)
+		{
+			flushFrames();
+		}
+		return byteArray.size();
+	}
 	return tcpSocket->write(byteArray); // writes data to internal buffer and returns full size always; then emits signals
 }
 
+void QWsSocket::setCorked(bool c)
+{
+	corked = c;
+	if (!corked)
+	{
+		flushFrames();
+	}
+}
+
+bool QWsSocket::isCorked()
+{
+	return corked;
+}
+
+void QWsSocket::setCorkThreshold(int bytes)
+{
+	_corkThreshold = bytes;
+}
+
+int QWsSocket::corkThreshold()
+{
+	return _corkThreshold;
+}
+
+void QWsSocket::setMaxMessageSize(int bytes)
+{
+	_maxMessageSize = bytes;
+}
+
+int QWsSocket::maxMessageSize()
+{
+	return _maxMessageSize;
+}
+
+qint64 QWsSocket::pendingBytes()
+{
+	return tcpSocket->bytesToWrite() + corkedBytes;
+}
+
+int QWsSocket::pendingMessages()
+{
+	// whatever is no longer pending has been sent
+	qint64 sentBytes = queuedBytes - pendingBytes();
+	while (!pendingMessageEnds.isEmpty() && pendingMessageEnds.head() <= sentBytes)
+	{
+		pendingMessageEnds.dequeue();
+	}
+	return pendingMessageEnds.size();
+}
+
+void QWsSocket::markMessageEnd()
+{
+	pendingMessageEnds.enqueue(queuedBytes);
+	// forgets messages sent meanwhile, the queue stays as long as the backlog
+	pendingMessages();
+}
+
+qint64 QWsSocket::flushFrames()
+{
+	if (corkedFrames.isEmpty())
+	{
+		return 0;
+	}
+
+	qint64 written = 0;
+	int index = 0;
+	int offset = 0;
+
+	// nothing buffered ahead of the queue, it can go straight to the kernel
+	// in gathered writes; the TCP socket would send its buffer one chunk,
+	// one shared frame, at a time. TLS sockets, client or server side, have
+	// to encrypt it first.
+	QSslSocket* sslSocket = qobject_cast<QSslSocket*>(tcpSocket);
+	bool plain = sslSocket == NULL || sslSocket->mode() == QSslSocket::UnencryptedMode;
+	if (plain && tcpSocket->bytesToWrite() == 0)
+	{
+		written = sendGathered(index, offset);
+	}
+
+	// whatever the kernel didn't take is buffered for the TCP socket to send
+	for (; index < corkedFrames.size(); index++)
+	{
+		const QByteArray& frame = corkedFrames.at(index);
+		written += tcpSocket->write(frame.constData() + offset, frame.size() - offset);
+		offset = 0;
+	}
+	corkedFrames.clear();
+	corkedTailOwned = false;
+	corkedBytes = 0;
+	tcpSocket->flush();
+	return written;
+}
+
+qint64 QWsSocket::sendGathered(int& index, int& offset)
+{
+	qint64 sent = 0;
+
+#ifdef Q_OS_LINUX
+	const int descriptor = (int)tcpSocket->socketDescriptor();
+	if (descriptor == -1)
+	{
+		return 0;
+	}
+
+	while (index < corkedFrames.size())
+	{
+		iovec vectors[maxGatheredFrames];
+		int count = 0;
+		for (int i = index; i < corkedFrames.size() && count < maxGatheredFrames; i++, count++)
+		{
+			int skip = (i == index ? offset : 0);
+			vectors[count].iov_base = const_cast<char*>(corkedFrames.at(i).constData()) + skip;
+			vectors[count].iov_len = corkedFrames.at(i).size() - skip;
+		}
+
+		msghdr message = {};
+		message.msg_iov = vectors;
+		message.msg_iovlen = count;
+
+		// a full send buffer or an error, the TCP socket takes the rest
+		// and reports whatever went wrong
+		ssize_t result = ::sendmsg(descriptor, &message, MSG_NOSIGNAL);
+		if (result <= 0)
+		{
+			break;
+		}
+		sent += result;
+
+		// skip what went out, the last frame possibly only partly
+		while (result > 0)
+		{
+			qint64 left = corkedFrames.at(index).size() - offset;
+			if (result < left)
+			{
+				offset += result;
+				result = 0;
+			}
+			else
+			{
+				result -= left;
+				index++;
+				offset = 0;
+			}
+		}
+	}
+#else
+	Q_UNUSED(index);
+	Q_UNUSED(offset);
+#endif
+
+	return sent;
+}
+
 qint64 QWsSocket::writeFrames(const QList<QByteArray>& framesList)
 {
 	qint64 nbBytesWritten = 0;
@@ -786,6 +1068,7 @@ void QWsSocket::processTcpStateChanged(QAbstractSocket::SocketState tcpSocketSta
 			}
 			closingHandshakeSent = false;
 			closingHandshakeReceived = false;
+			discardReceived();
 			break;
 		}
 		default:
@@ -928,15 +1211,49 @@ QByteArray QWsSocket::computeAcceptV4(QByteArray key)
 
 QByteArray QWsSocket::mask(const QByteArray& data, QByteArray& maskingKey)
 {
-	QByteArray result;
-	result.reserve(data.size());
+	QByteArray result(data);
+	QWsSocket::maskInPlace(result.data(), result.size(), maskingKey.constData());
+	return result;
+}
+
+void QWsSocket::maskInPlace(char* data, qint64 size, const char* maskingKey)
+{
+	// every step is a multiple of 4 bytes, so the key keeps its phase
+	qint64 i = 0;
 
-	for (int i=0 ; i<data.size() ; i++)
+#ifdef __SSE2__
+	quint32 key32;
+	memcpy(&key32, maskingKey, 4);
+	const __m128i key128 = _mm_set1_epi32((int)key32);
+	for (; i + 32 <= size ; i += 32)
+	{
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 16));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_xor_si128(a, key128));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(data + i + 16), _mm_xor_si128(b, key128));
+	}
+	for (; i + 16 <= size ; i += 16)
 	{
-		result[i] = (data[i] ^ maskingKey[i % 4]);
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_xor_si128(a, key128));
 	}
+#endif
 
-	return result;
+	quint64 key64;
+	memcpy(&key64, maskingKey, 4);
+	memcpy(reinterpret_cast<char*>(&key64) + 4, maskingKey, 4);
+	for (; i + 8 <= size ; i += 8)
+	{
+		quint64 word;
+		memcpy(&word, data + i, 8);
+		word ^= key64;
+		memcpy(data + i, &word, 8);
+	}
+
+	for (; i < size ; i++)
+	{
+		data[i] ^= maskingKey[i & 3];
+	}
 }
 
 QList<QByteArray> QWsSocket::composeFrames(QByteArray data, Opcode opcode, QByteArray maskingKey, int maxFrameBytes)
@@ -948,6 +1265,7 @@ QList<QByteArray> QWsSocket::composeFrames(QByteArray data, Opcode opcode, QByte
 
 	QList<QByteArray> frames;
 	int nbFrames = (data.size() / maxFrameBytes) + 1;
+	int offset = 0;
 
 	for (int i=0; i<nbFrames; i++)
 	{
@@ -966,31 +1284,49 @@ QList<QByteArray> QWsSocket::composeFrames(QByteArray data, Opcode opcode, QByte
 		if (i == nbFrames-1) // for multi-frames
 		{
 			final = true;
-			frameSize = data.size();
+			frameSize = data.size() - offset;
 		}
 
 		// Compose and append the header to the frame
-		frame.append(QWsSocket::composeHeader(final, frameOpcode, frameSize, maskingKey));
-		
+		QByteArray header = QWsSocket::composeHeader(final, frameOpcode, frameSize, maskingKey);
+		frame.reserve(header.size() + frameSize);
+		frame.append(header);
+
 		// Application Data
-		QByteArray frameData = data.left(frameSize);
-		data.remove(0, frameSize);
-		
+		int payloadStart = frame.size();
+		frame.append(data.constData() + offset, frameSize);
+		offset += frameSize;
+
 		// mask frame data if necessary
 		if (maskingKey.size())
 		{
-			frameData = QWsSocket::mask(frameData, maskingKey);
+			QWsSocket::maskInPlace(frame.data() + payloadStart, frameSize, maskingKey.constData());
 		}
 
-		// append payload to the frame
-		frame.append(frameData);
-
 		// append frame to framesList
 		frames << frame;
 	}
 	return frames;
 }
 
+QByteArray QWsSocket::composeSharedFrames(const QByteArray& data, Opcode opcode)
+{
+	const QList<QByteArray> framesList = QWsSocket::composeFrames(data, opcode);
+
+	QByteArray frames;
+	int size = 0;
+	for (int i=0 ; i<framesList.size() ; i++)
+	{
+		size += framesList[i].size();
+	}
+	frames.reserve(size);
+	for (int i=0 ; i<framesList.size() ; i++)
+	{
+		frames.append(framesList[i]);
+	}
+	return frames;
+}
+
 QByteArray QWsSocket::composeHeader(bool end, Opcode opcode, quint64 payloadLength, QByteArray maskingKey)
 {
 	QByteArray BA;
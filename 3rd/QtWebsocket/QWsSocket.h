@@ -28,10 +28,12 @@ along with QtWebsocket.  If not, see <http://www.gnu.org/licenses/>.
 #include <QHostAddress>
 #include <QTime>
 #include <QStringList>
+#include <QQueue>
 
 #include "WsEnums.h"
 #include "QWsHandshake.h"
 #include "QWsFrame.h"
+#include "QWsDeflate.h"
 
 namespace QtWebsocket
 {
@@ -68,6 +70,39 @@ public:
 
 	qint64 write(const QString& string); // write data as text
 	qint64 write(const QByteArray & byteArray); // write data as binary
+	qint64 writeText(const QByteArray& utf8); // write UTF-8 encoded data as text
+	// write frames composed once by composeSharedFrames, data is what they carry
+	// for sockets that need it framed otherwise
+	qint64 writeSharedFrames(const QByteArray& frames, const QByteArray& data, bool asBinary = false);
+
+	/*!
+	 * While corked, written frames are queued and sent together by
+	 * `flushFrames` or as soon as `corkThreshold` bytes are pending. Shared
+	 * frames are queued without being copied. On Linux, when nothing is
+	 * buffered ahead of them, they go out in gathered writes (sendmsg) that
+	 * take up to `maxGatheredFrames` frames each. What the kernel doesn't take
+	 * is buffered by the TCP socket, which sends its buffer a frame at a time.
+	 */
+	void setCorked(bool corked);
+	bool isCorked();
+	void setCorkThreshold(int bytes);
+	int corkThreshold();
+	qint64 flushFrames();
+
+	/*!
+	 * Messages announcing more than `maxMessageSize` bytes, fragments
+	 * included, close the connection with `CloseTooMuchData` before any of
+	 * their payload is buffered.
+	 */
+	void setMaxMessageSize(int bytes);
+	int maxMessageSize();
+
+	/*!
+	 * Backlog of written data not sent yet: bytes corked or buffered by the
+	 * TCP socket, and messages not completely sent.
+	 */
+	qint64 pendingBytes();
+	int pendingMessages();
 
 public slots:
 	void connectToHost(const QString & hostName, quint16 port = 80, OpenMode mode = ReadWrite);
@@ -78,14 +113,22 @@ public slots:
 
 signals:
 	void frameReceived(QString frame);
+	// binary frames are views into the receive buffer, valid during the
+	// emission only: copy them before keeping them or queueing them
 	void frameReceived(QByteArray frame);
+	// text frames as their validated UTF-8 bytes, a view like binary frames
+	void textFrameReceived(QByteArray frame);
 	void pong(quint64 elapsedTime);
 	void encrypted();
 	void sslErrors(const QList<QSslError>& errors);
 
 protected:
 	qint64 writeFrames (const QList<QByteArray>& framesList);
-	qint64 writeFrame (const QByteArray& byteArray);
+	// shared frames are queued by reference when corked, not copied
+	qint64 writeFrame (const QByteArray& byteArray, bool shared = false);
+	// sends the corked frames from `offset` into frame `index` on, moving
+	// both past whatever the kernel took
+	qint64 sendGathered(int& index, int& offset);
 	inline qint64 internalWrite(const QByteArray& string, bool asBinary);
 	void initTcpSocket();
 
@@ -112,11 +155,29 @@ private:
 	QByteArray currentData;
 	Opcode currentDataOpcode;
 
+	/*!
+	 * permessage-deflate state, NULL unless negotiated in the handshake.
+	 */
+	QWsDeflate* _deflate;
+	bool currentDataCompressed;
+	QByteArray inflatedData;
+	QByteArray deflatedData;
+
 	/*!
 	 * True if we are waiting for a final data fragment.
 	 */
 	bool continuation;
 
+	/*!
+	 * Bytes received but not yet parsed, frames start at `receiveOffset`.
+	 *
+	 * Payloads are unmasked in place and unfragmented messages handed over
+	 * straight from here.
+	 */
+	QByteArray receiveBuffer;
+	int receiveOffset;
+	int _maxMessageSize;
+
 	EWebsocketVersion _version;
 	QString _resourceName;
 	QString _hostName;
@@ -146,6 +207,21 @@ private:
 
 	bool _secured;
 
+	bool corked;
+	int _corkThreshold;
+	// shared frames as they are, the socket's own frames between them
+	// appended into one buffer each run
+	QList<QByteArray> corkedFrames;
+	bool corkedTailOwned;
+	qint64 corkedBytes;
+
+	/*!
+	 * Bytes ever written, and the count at which each message still
+	 * pending ends.
+	 */
+	qint64 queuedBytes;
+	QQueue<qint64> pendingMessageEnds;
+
 	/*!
 	 * Sends pong response with `applicationData` appended.
 	 */
@@ -155,17 +231,29 @@ private:
 	 * Processes the joined payload of the previous frames.
 	 *
 	 * Called if the final and valid non-control frame has been received.
+	 * `data` points into the receive buffer or `currentData` and is only
+	 * valid during the call.
 	 */
-	void handleData();
+	void handleData(const char* data, int size);
 
 	/*!
 	 * Processes the current control frame.
 	 *
 	 * Responds to ping and pong or closes connection according to
 	 * `currentOpcode`. Called if a complete and valid control frame has been
-	 * received.
+	 * received, `payload` is a view into the receive buffer.
+	 */
+	void handleControlFrame(const QByteArray& payload);
+
+	/*!
+	 * Drops everything received so far, called on protocol errors.
+	 */
+	void discardReceived();
+
+	/*!
+	 * Records the end of a message just written, for `pendingMessages`.
 	 */
-	void handleControlFrame();
+	void markMessageEnd();
 
 public:
 	// Static functions
@@ -177,8 +265,24 @@ public:
 	static QByteArray computeAcceptV0(QByteArray key1, QByteArray key2, QByteArray thirdPart);
 	static QByteArray computeAcceptV4(QByteArray key);
 	static QByteArray mask(const QByteArray& data, QByteArray& maskingKey);
+
+	/*!
+	 * XORs `size` bytes of `data` with the 4 byte `maskingKey`, 16 bytes at a
+	 * time where SSE2 is available and 8 otherwise.
+	 *
+	 * Masking and unmasking are the same operation.
+	 */
+	static void maskInPlace(char* data, qint64 size, const char* maskingKey);
 	static QList<QByteArray> composeFrames(QByteArray data, Opcode opcode = OpText, QByteArray maskingKey = QByteArray(), int maxFrameBytes = 0);
 	static QByteArray composeHeader(bool end, Opcode opcode, quint64 payloadLength, QByteArray maskingKey = QByteArray());
+
+	/*!
+	 * Composes the unmasked frames of `data` into one buffer.
+	 *
+	 * Server side sockets send unmasked frames, so the result can be shared by
+	 * any number of them through `writeSharedFrames`.
+	 */
+	static QByteArray composeSharedFrames(const QByteArray& data, Opcode opcode = OpText);
 	static QString composeOpeningHandShakeV0(QString resourceName, QString host, QByteArray key1, QByteArray key2, QByteArray key3, QString origin = "", QString protocol = "", QString extensions = "");
 	static QString composeOpeningHandShakeV13(QString resourceName, QString host, QByteArray key, QString origin = "", QString protocol = "", QString extensions = "");
 
@@ -192,6 +296,12 @@ public:
 
 	// static vars
 	static const int maxBytesPerFrame = 1400;
+	static const int receiveBufferReserve = 4096;
+	// as much as a compressed message may inflate to
+	static const int defaultMaxMessageSize = 1 << 20;
+	static const int defaultCorkThreshold = 16384;
+	// well under any IOV_MAX
+	static const int maxGatheredFrames = 64;
 	static const QLatin1String emptyLine;
 	static QRegExp regExpIPv4;
 	static QRegExp regExpHttpRequest;
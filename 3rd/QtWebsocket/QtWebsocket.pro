@@ -23,6 +23,7 @@ SOURCES += \
     QWsSocket.cpp \
     QWsHandshake.cpp \
     QWsFrame.cpp \
+    QWsDeflate.cpp \
     QTlsServer.cpp \
     functions.cpp
 
@@ -31,6 +32,7 @@ HEADERS += \
     QWsSocket.h \
     QWsHandshake.h \
     QWsFrame.h \
+    QWsDeflate.h \
     QTlsServer.h \
     functions.h \
     WsEnums.h
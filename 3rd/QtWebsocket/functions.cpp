@@ -19,6 +19,7 @@ along with QtWebsocket.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <QtCore/qmath.h>
 #include <climits>
+#include <cstring>
 
 namespace QtWebsocket
 {
@@ -98,4 +99,82 @@ quint64 rand64(quint64 low, quint64 high)
 	return low + (myRand % (high - low + 1));
 }
 
+bool isValidUtf8(const char* data, qint64 size)
+{
+	const uchar* bytes = reinterpret_cast<const uchar*>(data);
+	qint64 i = 0;
+	while (i < size)
+	{
+		// runs of ASCII are skipped 8 bytes at a time
+		if (i + 8 <= size)
+		{
+			quint64 word;
+			memcpy(&word, bytes + i, 8);
+			if ((word & Q_UINT64_C(0x8080808080808080)) == 0)
+			{
+				i += 8;
+				continue;
+			}
+		}
+
+		uchar lead = bytes[i];
+		if (lead < 0x80)
+		{
+			i++;
+			continue;
+		}
+
+		// range of the second byte depends on the lead byte
+		int length = 0;
+		uchar low = 0x80;
+		uchar high = 0xBF;
+		if (lead >= 0xC2 && lead <= 0xDF)
+		{
+			length = 2;
+		}
+		else if (lead >= 0xE0 && lead <= 0xEF)
+		{
+			length = 3;
+			if (lead == 0xE0)
+			{
+				low = 0xA0;
+			}
+			else if (lead == 0xED)
+			{
+				high = 0x9F;
+			}
+		}
+		else if (lead >= 0xF0 && lead <= 0xF4)
+		{
+			length = 4;
+			if (lead == 0xF0)
+			{
+				low = 0x90;
+			}
+			else if (lead == 0xF4)
+			{
+				high = 0x8F;
+			}
+		}
+		else
+		{
+			return false;
+		}
+
+		if (i + length > size || bytes[i + 1] < low || bytes[i + 1] > high)
+		{
+			return false;
+		}
+		for (int k = 2 ; k < length ; k++)
+		{
+			if ((bytes[i + k] & 0xC0) != 0x80)
+			{
+				return false;
+			}
+		}
+		i += length;
+	}
+	return true;
+}
+
 } // namespace QtWebsocket
@@ -31,6 +31,9 @@ quint16 rand16(quint16 low = 0, quint16 high = 0);
 quint32 rand32(quint32 low = 0, quint32 high = 0);
 quint64 rand64(quint64 low = 0, quint64 high = 0);
 
+// strict RFC 3629: no overlong forms, surrogates or code points past U+10FFFF
+bool isValidUtf8(const char* data, qint64 size);
+
 } // namespace QtWebsocket
 
 #endif // QTWS_FUNCTIONS_H
@@ -0,0 +1,28 @@
+# Checks QWsSocket::maskInPlace against byte-wise masking and reports the
+# throughput of both, run it after touching the masking code
+
+QT += network
+
+QT -= gui
+
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+QMAKE_CXXFLAGS += -std=c++11
+
+TARGET = maskbench
+DESTDIR = ../../../../bin
+
+INCLUDEPATH += ../..
+
+LIBS += -L../../../lib
+LIBS += -lz
+
+CONFIG(debug, debug|release) {
+    LIBS += -lQtWebsocketd
+} else {
+    LIBS += -lQtWebsocket
+}
+
+SOURCES += main.cpp
@@ -126,11 +126,48 @@ void QHttpConnection::flush()
     m_socket->flush();
 }
 
+void QHttpConnection::write(QHttpResponse *response, const QByteArray &data)
+{
+    if (!m_responses.isEmpty() && m_responses.head().response == response) {
+        write(data);
+        return;
+    }
+
+    for (int i = 1; i < m_responses.size(); ++i) {
+        if (m_responses[i].response == response) {
+            m_responses[i].data.append(data);
+            return;
+        }
+    }
+}
+
 void QHttpConnection::responseDone()
 {
     QHttpResponse *response = qobject_cast<QHttpResponse *>(QObject::sender());
-    if (response->m_last)
-        m_socket->disconnectFromHost();
+
+    for (int i = 0; i < m_responses.size(); ++i) {
+        if (m_responses[i].response == response) {
+            // it deletes itself, only its data waits here
+            m_responses[i].response = 0;
+            m_responses[i].done = true;
+            m_responses[i].last = response->m_last;
+            break;
+        }
+    }
+
+    // the next responses in line may have finished already
+    while (!m_responses.isEmpty() && m_responses.head().done) {
+        PendingResponse finished = m_responses.dequeue();
+        if (finished.last) {
+            m_responses.clear();
+            m_socket->disconnectFromHost();
+            return;
+        }
+        if (!m_responses.isEmpty()) {
+            write(m_responses.head().data);
+            m_responses.head().data.clear();
+        }
+    }
 }
 
 /* URL Utilities */
@@ -219,9 +256,16 @@ int QHttpConnection::HeadersComplete(http_parser *parser)
     theConnection->m_request->m_remotePort = theConnection->m_socket->peerPort();
 
     QHttpResponse *response = new QHttpResponse(theConnection);
-    if (parser->http_major < 1 || parser->http_minor < 1)
+    // HTTP/1.0 without keep-alive or a request with Connection: close
+    if (!http_should_keep_alive(parser))
         response->m_keepAlive = false;
 
+    PendingResponse pending;
+    pending.response = response;
+    pending.done = false;
+    pending.last = false;
+    theConnection->m_responses.enqueue(pending);
+
     connect(theConnection, SIGNAL(destroyed()), response, SLOT(connectionClosed()));
     connect(response, SIGNAL(done()), theConnection, SLOT(responseDone()));
 
@@ -27,6 +27,8 @@
 #include "qhttpserverfwd.h"
 
 #include <QObject>
+#include <QPointer>
+#include <QQueue>
 
 /// @cond nodoc
 
@@ -41,6 +43,10 @@ public:
     void write(const QByteArray &data);
     void flush();
 
+    // Writes data of a response. Responses to pipelined requests go out in
+    // request order, those finished early are held back until their turn.
+    void write(QHttpResponse *response, const QByteArray &data);
+
 signals:
     void newRequest(QHttpRequest *, QHttpResponse *);
     void allBytesWritten();
@@ -66,7 +72,18 @@ private:
     http_parser_settings *m_parserSettings;
 
     // Since there can only be one request at any time even with pipelining.
-    QHttpRequest *m_request;
+    // Deleting it is up to the user, possibly before the connection is gone.
+    QPointer<QHttpRequest> m_request;
+
+    // Responses in request order, the head one writes through
+    struct PendingResponse
+    {
+        QHttpResponse *response;
+        QByteArray data;
+        bool done;
+        bool last;
+    };
+    QQueue<PendingResponse> m_responses;
 
     QByteArray m_currentUrl;
     // The ones we are reading in from the parser
@@ -60,10 +60,10 @@ void QHttpResponse::setHeader(const QString &field, const QString &value)
 void QHttpResponse::writeHeader(const char *field, const QString &value)
 {
     if (!m_finished) {
-        m_connection->write(field);
-        m_connection->write(": ");
-        m_connection->write(value.toUtf8());
-        m_connection->write("\r\n");
+        m_connection->write(this, field);
+        m_connection->write(this, ": ");
+        m_connection->write(this, value.toUtf8());
+        m_connection->write(this, "\r\n");
     } else
         qWarning()
             << "QHttpResponse::writeHeader() Cannot write headers after response has finished.";
@@ -133,10 +133,10 @@ void QHttpResponse::writeHead(int status)
         return;
     }
 
-    m_connection->write(
+    m_connection->write(this,
         QString("HTTP/1.1 %1 %2\r\n").arg(status).arg(STATUS_CODES[status]).toLatin1());
     writeHeaders();
-    m_connection->write("\r\n");
+    m_connection->write(this, "\r\n");
 
     m_headerWritten = true;
 }
@@ -158,7 +158,7 @@ void QHttpResponse::write(const QByteArray &data)
         return;
     }
 
-    m_connection->write(data);
+    m_connection->write(this, data);
 }
 
 void QHttpResponse::end(const QByteArray &data)
@@ -77,6 +77,7 @@ public:
         STATUS_REQUEST_UNSUPPORTED_MEDIA_TYPE = 415,
         STATUS_REQUESTED_RANGE_NOT_SATISFIABLE = 416,
         STATUS_EXPECTATION_FAILED = 417,
+        STATUS_TOO_MANY_REQUESTS = 429,
         STATUS_INTERNAL_SERVER_ERROR = 500,
         STATUS_NOT_IMPLEMENTED = 501,
         STATUS_BAD_GATEWAY = 502,
@@ -29,9 +29,17 @@
 
 #include "qhttpconnection.h"
 
+#if defined(Q_OS_UNIX)
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <string.h>
+#endif
+
 QHash<int, QString> STATUS_CODES;
 
-QHttpServer::QHttpServer(QObject *parent) : QObject(parent), m_tcpServer(0)
+QHttpServer::QHttpServer(QObject *parent) : QObject(parent), m_tcpServer(0), m_reusePort(false)
 {
 #define STATUS_CODE(num, reason) STATUS_CODES.insert(num, reason);
     // {{{
@@ -77,6 +85,7 @@ QHttpServer::QHttpServer(QObject *parent) : QObject(parent), m_tcpServer(0)
     STATUS_CODE(424, "Failed Dependency")    // RFC 4918
     STATUS_CODE(425, "Unordered Collection") // RFC 4918
     STATUS_CODE(426, "Upgrade Required")     // RFC 2817
+    STATUS_CODE(429, "Too Many Requests")    // RFC 6585
     STATUS_CODE(500, "Internal Server Error")
     STATUS_CODE(501, "Not Implemented")
     STATUS_CODE(502, "Bad Gateway")
@@ -112,7 +121,9 @@ bool QHttpServer::listen(const QHostAddress &address, quint16 port)
     Q_ASSERT(!m_tcpServer);
     m_tcpServer = new QTcpServer(this);
 
-    bool couldBindToPort = m_tcpServer->listen(address, port);
+    bool couldBindToPort = m_reusePort && reusePortSupported()
+                           ? listenReusePort(address, port)
+                           : m_tcpServer->listen(address, port);
     if (couldBindToPort) {
         connect(m_tcpServer, SIGNAL(newConnection()), this, SLOT(newConnection()));
     } else {
@@ -127,6 +138,73 @@ bool QHttpServer::listen(quint16 port)
     return listen(QHostAddress::Any, port);
 }
 
+void QHttpServer::setReusePort(bool reusePort)
+{
+    m_reusePort = reusePort;
+}
+
+bool QHttpServer::reusePortSupported()
+{
+#if defined(Q_OS_UNIX) && defined(SO_REUSEPORT)
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool QHttpServer::listenReusePort(const QHostAddress &address, quint16 port)
+{
+#if defined(Q_OS_UNIX) && defined(SO_REUSEPORT)
+    // QTcpServer can't set the option before binding, so the socket is
+    // set up here and handed over already listening
+    bool ipv4 = address.protocol() == QAbstractSocket::IPv4Protocol;
+    int fd = ::socket(ipv4 ? AF_INET : AF_INET6, SOCK_STREAM, 0);
+    if (fd == -1)
+        return false;
+
+    int on = 1;
+    int off = 0;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) == -1) {
+        ::close(fd);
+        return false;
+    }
+
+    int result;
+    if (ipv4) {
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(address.toIPv4Address());
+        result = ::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    } else {
+        // QHostAddress::Any accepts IPv4 clients as well
+        if (address == QHostAddress::Any)
+            ::setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+
+        sockaddr_in6 addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin6_family = AF_INET6;
+        addr.sin6_port = htons(port);
+        Q_IPV6ADDR ip = address == QHostAddress::Any ? QHostAddress(QHostAddress::AnyIPv6).toIPv6Address()
+                                                     : address.toIPv6Address();
+        memcpy(&addr.sin6_addr, &ip, sizeof(ip));
+        result = ::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    }
+
+    if (result == -1 || ::listen(fd, SOMAXCONN) == -1 || !m_tcpServer->setSocketDescriptor(fd)) {
+        ::close(fd);
+        return false;
+    }
+    return true;
+#else
+    Q_UNUSED(address);
+    Q_UNUSED(port);
+    return false;
+#endif
+}
+
 void QHttpServer::close()
 {
     if (m_tcpServer)
@@ -81,6 +81,16 @@ public:
 
     /// Stop the server and listening for new connections.
     void close();
+
+    /// Lets several servers listen on the same port, the kernel spreads
+    /// new connections between them.
+    /** Has to be set before calling listen(). Only takes effect where
+        SO_REUSEPORT is available, see reusePortSupported().
+        @param reusePort Whether to bind with SO_REUSEPORT. */
+    void setReusePort(bool reusePort);
+
+    /// Whether setReusePort() has any effect on this platform.
+    static bool reusePortSupported();
 signals:
     /// Emitted when a client makes a new request to the server.
     /** The slot should use the given @c request and @c response
@@ -93,7 +103,10 @@ private slots:
     void newConnection();
 
 private:
+    bool listenReusePort(const QHostAddress &address, quint16 port);
+
     QTcpServer *m_tcpServer;
+    bool m_reusePort;
 };
 
 #endif
@@ -4,8 +4,11 @@ TEMPLATE = subdirs
 
 SUBDIRS += 3rd/qhttpserver \
            3rd/QtWebsocket \
-           server
+           server \
+           3rd/QtWebsocket/tests/maskbench
 
 server.depends += qhttpserver \
                   QtWebsocket
+
+maskbench.depends += QtWebsocket
                   
\ No newline at end of file
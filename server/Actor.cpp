@@ -82,6 +82,16 @@ void Actor::Update(float dt)
     SetDirection(EActorDirection::NONE);
 }
 
+float Actor::GetPendingTime() const
+{
+    return pendingTime_;
+}
+
+void Actor::SetPendingTime(const float pendingTime)
+{
+    pendingTime_ = pendingTime;
+}
+
 int Actor::GetId() const
 {
     return id_;
@@ -109,19 +119,21 @@ QString Actor::GetType() const
 
 std::vector<std::pair<int, int>> Actor::GetOccupiedCells() const
 {
+    // every cell between the corners once, range queries on the
+    // level map rely on an actor being indexed in all of them
+    float half = GetSize() * 0.5f;
+    int minColumn = GridRound(GetPosition().x - half);
+    int minRow = GridRound(GetPosition().y - half);
+    int maxColumn = GridRound(GetPosition().x + half);
+    int maxRow = GridRound(GetPosition().y + half);
+
     std::vector<std::pair<int, int>> result;
-    Vector2 dp[4];
-    for (int i = 0; i < 4; i++)
+    for (int row = minRow; row <= maxRow; row++)
     {
-        Vector2 p = GetPosition()
-                    + GetSize()
-                    * 0.5
-                    * Deku2D::Const::Math::V2_DIRECTIONS_DIAG[i];
-
-        int column = GridRound(p.x);
-        int row = GridRound(p.y);
-
-        result.push_back(std::make_pair(column, row));
+        for (int column = minColumn; column <= maxColumn; column++)
+        {
+            result.push_back(std::make_pair(column, row));
+        }
     }
     return result;
 }
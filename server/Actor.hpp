@@ -47,6 +47,10 @@ public:
 
     virtual void Update(float dt);
 
+    // simulation time accumulated while the actor's region skipped ticks
+    float GetPendingTime() const;
+    void SetPendingTime(const float pendingTime);
+
     int GetId() const;
     void SetId(int id);
 
@@ -63,6 +67,7 @@ protected:
     Vector2 velocity_ = Const::Math::V2_ZERO;
     EActorDirection direction_ = EActorDirection::NONE;
     float size_ = 1.0f;
+    float pendingTime_ = 0.0f;
     int id_ = -1;
     QString type_ = "undefined";
 };
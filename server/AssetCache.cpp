@@ -0,0 +1,328 @@
+#include "AssetCache.hpp"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QMutexLocker>
+#include <QRegularExpression>
+
+#include <zlib.h>
+
+AssetCache::AssetCache(const QString& root, QObject* parent)
+    : QObject(parent)
+    , root_(QDir(root).absolutePath())
+{
+    watcher_ = new QFileSystemWatcher(this);
+
+    connect(watcher_
+            , &QFileSystemWatcher::fileChanged
+            , this
+            , &AssetCache::fileChanged);
+
+    connect(watcher_
+            , &QFileSystemWatcher::directoryChanged
+            , this
+            , &AssetCache::directoryChanged);
+
+    Reload();
+}
+
+AssetCache::~AssetCache()
+{
+
+}
+
+std::shared_ptr<const AssetCache::Asset> AssetCache::Get(const QString& path) const
+{
+    QMutexLocker locker(&mutex_);
+    return assets_.value(path);
+}
+
+void AssetCache::Reload()
+{
+    {
+        QMutexLocker locker(&mutex_);
+        assets_.clear();
+    }
+    pageSources_.clear();
+    LoadDirectory_(root_);
+    RenderPages_();
+}
+
+void AssetCache::fileChanged(const QString& filePath)
+{
+    // editors often replace the file, that drops it from the watcher
+    LoadFile_(filePath);
+    RenderPages_();
+}
+
+void AssetCache::directoryChanged(const QString& directoryPath)
+{
+    // files were added or removed, whatever is gone is forgotten
+    {
+        QMutexLocker locker(&mutex_);
+        QString prefix = ToPath_(directoryPath) + "/";
+        for (auto it = assets_.begin(); it != assets_.end();)
+        {
+            bool inDirectory = it.key().startsWith(prefix)
+                               && it.key().indexOf('/', prefix.size()) == -1;
+            if (inDirectory && !QFileInfo::exists(root_ + it.key()))
+            {
+                pageSources_.remove(it.key());
+                it = assets_.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+    LoadDirectory_(directoryPath);
+    RenderPages_();
+}
+
+void AssetCache::LoadDirectory_(const QString& directoryPath)
+{
+    watcher_->addPath(directoryPath);
+
+    QDirIterator it(directoryPath, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+    while (it.hasNext())
+    {
+        QString filePath = it.next();
+        if (it.fileInfo().isDir())
+        {
+            LoadDirectory_(filePath);
+        }
+        else
+        {
+            bool loaded = false;
+            {
+                QMutexLocker locker(&mutex_);
+                loaded = assets_.contains(ToPath_(filePath));
+            }
+            if (!loaded)
+            {
+                LoadFile_(filePath);
+            }
+        }
+    }
+}
+
+void AssetCache::LoadFile_(const QString& filePath)
+{
+    QString path = ToPath_(filePath);
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        pageSources_.remove(path);
+        QMutexLocker locker(&mutex_);
+        assets_.remove(path);
+        return;
+    }
+
+    QByteArray data = file.readAll();
+    QString contentType = GetContentType_(filePath);
+
+    // served as loaded until RenderPages_ versions its urls
+    if (contentType.startsWith("text/html"))
+    {
+        pageSources_[path] = data;
+    }
+
+    auto asset = MakeAsset_(data, contentType);
+
+    watcher_->addPath(filePath);
+
+    QMutexLocker locker(&mutex_);
+    assets_[path] = asset;
+}
+
+QString AssetCache::ToPath_(const QString& filePath) const
+{
+    return QDir(filePath).absolutePath().mid(root_.size());
+}
+
+void AssetCache::RenderPages_()
+{
+    for (auto it = pageSources_.begin(); it != pageSources_.end(); ++it)
+    {
+        QString contentType;
+        {
+            QMutexLocker locker(&mutex_);
+            auto asset = assets_.value(it.key());
+            if (!asset)
+            {
+                continue;
+            }
+            contentType = asset->contentType;
+        }
+
+        auto asset = MakeAsset_(RenderPage_(it.key(), it.value()), contentType);
+
+        QMutexLocker locker(&mutex_);
+        assets_[it.key()] = asset;
+    }
+}
+
+QByteArray AssetCache::RenderPage_(const QString& path, const QByteArray& page) const
+{
+    QString directory = path.left(path.lastIndexOf('/') + 1);
+
+    // pages aren't versioned, a page linking to itself would never settle
+    QHash<QString, QByteArray> versions;
+    {
+        QMutexLocker locker(&mutex_);
+        for (auto it = assets_.begin(); it != assets_.end(); ++it)
+        {
+            if (!pageSources_.contains(it.key()))
+            {
+                versions[it.key()] = it.value()->version;
+            }
+        }
+    }
+
+    // modules are loaded by require.js from its base url, the directory
+    // of data-main, it is told their versioned urls through the config
+    // it picks up from a require variable defined before it loads
+    QString text = QString::fromUtf8(page);
+    QRegularExpression mainPattern("<script[^>]*\\sdata-main=\"([^\"?#:]+)\"");
+    auto main = mainPattern.match(text);
+    QString config;
+    if (main.hasMatch())
+    {
+        QString mainPath = QDir::cleanPath(directory + main.captured(1));
+        QString baseUrl = mainPath.left(mainPath.lastIndexOf('/') + 1);
+        QStringList modules;
+        for (auto it = versions.begin(); it != versions.end(); ++it)
+        {
+            if (it.key().startsWith(baseUrl) && it.key().endsWith(".js"))
+            {
+                QString module = it.key().mid(baseUrl.size());
+                module.chop(3);
+                // a "?" keeps require.js from appending ".js" again
+                modules.append(QString("\"%1\": \"%1.js?v=%2\"")
+                               .arg(module, QString::fromLatin1(it.value())));
+            }
+        }
+        modules.sort();
+        config = "<script>var require = {paths: {"
+                 + modules.join(", ")
+                 + "}};</script>\n";
+    }
+
+    // urls of assets the cache has, others are left alone
+    QRegularExpression urlPattern("\\b(href|src)=\"([^\"?#:]+)\"");
+    QString result;
+    int last = 0;
+    auto matches = urlPattern.globalMatch(text);
+    while (matches.hasNext())
+    {
+        auto match = matches.next();
+        QString url = match.captured(2);
+        QString assetPath = QDir::cleanPath(url.startsWith('/') ? url : directory + url);
+        auto version = versions.find(assetPath);
+        if (version == versions.end())
+        {
+            continue;
+        }
+        result += text.midRef(last, match.capturedEnd(2) - last);
+        result += "?v=" + QString::fromLatin1(version.value());
+        last = match.capturedEnd(2);
+    }
+    result += text.midRef(last);
+
+    if (!config.isEmpty())
+    {
+        // the same tag is found again in the rewritten page
+        result.insert(mainPattern.match(result).capturedStart(), config);
+    }
+    return result.toUtf8();
+}
+
+std::shared_ptr<AssetCache::Asset> AssetCache::MakeAsset_(const QByteArray& data, const QString& contentType)
+{
+    std::shared_ptr<Asset> asset = std::make_shared<Asset>();
+    asset->data = data;
+    asset->contentType = contentType;
+
+    auto hash = QCryptographicHash::hash(asset->data, QCryptographicHash::Sha1).toHex().left(20);
+    asset->etag = "\"" + hash + "\"";
+    asset->version = hash;
+
+    // images are compressed already
+    if (asset->contentType.startsWith("text/")
+        || asset->contentType.startsWith("application/"))
+    {
+        QByteArray gzipped = Gzip_(asset->data);
+        if (!gzipped.isEmpty() && gzipped.size() < asset->data.size())
+        {
+            asset->gzipped = gzipped;
+            asset->gzippedEtag = "\"" + hash + "-gz\"";
+        }
+    }
+
+    return asset;
+}
+
+QByteArray AssetCache::Gzip_(const QByteArray& data)
+{
+    z_stream stream = {};
+    // 16 over the window bits asks for a gzip header
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        return QByteArray();
+    }
+
+    QByteArray result;
+    result.resize(deflateBound(&stream, data.size()));
+
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+    stream.avail_in = data.size();
+    stream.next_out = reinterpret_cast<Bytef*>(result.data());
+    stream.avail_out = result.size();
+
+    bool done = deflate(&stream, Z_FINISH) == Z_STREAM_END;
+    result.resize(result.size() - stream.avail_out);
+    deflateEnd(&stream);
+
+    return done ? result : QByteArray();
+}
+
+QString AssetCache::GetContentType_(const QString& filePath)
+{
+    auto extension = QFileInfo(filePath).suffix();
+
+    if (extension == "htm"
+        || extension == "html")
+    {
+        return "text/html; charset=utf-8";
+    }
+    else if (extension == "css")
+    {
+        return "text/css; charset=utf-8";
+    }
+    else if (extension == "js")
+    {
+        return "application/javascript; charset=utf-8";
+    }
+    else if (extension == "json")
+    {
+        return "application/json; charset=utf-8";
+    }
+    else if (extension == "png")
+    {
+        return "image/png";
+    }
+    else if (extension == "ico")
+    {
+        return "image/x-icon";
+    }
+    else
+    {
+        return "text/plain; charset=utf-8";
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <memory>
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+
+class QFileSystemWatcher;
+
+// Files of the client directory held in memory, each with a gzip variant
+// when it pays off and a strong ETag per variant. Loaded on startup and
+// reloaded whenever a file changes on disk. Pages refer to the other
+// assets by versioned urls, "chugun.css?v=<version>", those can be cached
+// for good since a change to the file changes the url.
+class AssetCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Asset
+    {
+        QByteArray data;
+        // empty if compression doesn't make it smaller
+        QByteArray gzipped;
+        QByteArray etag;
+        QByteArray gzippedEtag;
+        QString contentType;
+        // hash of the content, the "v" of versioned urls
+        QByteArray version;
+    };
+
+    AssetCache(const QString& root, QObject* parent = NULL);
+    virtual ~AssetCache();
+
+    // NULL for paths not found under the root, safe to call from any thread
+    std::shared_ptr<const Asset> Get(const QString& path) const;
+
+    void Reload();
+
+private slots:
+    void fileChanged(const QString& filePath);
+    void directoryChanged(const QString& directoryPath);
+
+private:
+    void LoadDirectory_(const QString& directoryPath);
+    void LoadFile_(const QString& filePath);
+    QString ToPath_(const QString& filePath) const;
+
+    // pages are rewritten whenever anything they may refer to changed
+    void RenderPages_();
+    QByteArray RenderPage_(const QString& path, const QByteArray& page) const;
+
+    static std::shared_ptr<Asset> MakeAsset_(const QByteArray& data, const QString& contentType);
+    static QByteArray Gzip_(const QByteArray& data);
+    static QString GetContentType_(const QString& filePath);
+
+    QString root_;
+    QFileSystemWatcher* watcher_;
+
+    mutable QMutex mutex_;
+    // keyed by request path, "/index.html"
+    QHash<QString, std::shared_ptr<const Asset>> assets_;
+    // pages as they are on disk, only touched by the cache's own thread
+    QHash<QString, QByteArray> pageSources_;
+};
@@ -29,3 +29,13 @@ void Creature::SetMaxHealth(const float maxHealth)
 {
     maxHealth_ = maxHealth;
 }
+
+Inventory& Creature::GetInventory()
+{
+    return inventory_;
+}
+
+const Inventory& Creature::GetInventory() const
+{
+    return inventory_;
+}
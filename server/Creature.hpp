@@ -1,10 +1,7 @@
 #pragma once
 
-#include <vector>
-
 #include "Actor.hpp"
-
-class Item;
+#include "Inventory.hpp"
 
 class Creature : public Actor
 {
@@ -18,10 +15,13 @@ public:
     float GetMaxHealth() const;
     void SetMaxHealth(const float maxHealth);
 
+    Inventory& GetInventory();
+    const Inventory& GetInventory() const;
+
 private:
     float health_ = 100.0f;
     float maxHealth_ = 100.0f;
 
-    // represents creature's inventory
-    std::vector<Item*> items_;
+    // cold data, rarely touched by the tick, kept last
+    Inventory inventory_;
 };
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <functional>
+
+#include <QVariantMap>
+
+// Takes the response to a FEMP request. Called exactly once, on whichever
+// thread finished the request, possibly before the request call returned.
+typedef std::function<void (const QVariantMap& response)> FEMPCallback;
+
+// Spent by every request from an address, whatever it asks for. Checked
+// by the connections before the request is even decoded, a little above
+// the sum of GameServer's per address limits of all the action classes
+// so that only a flood no class would admit anyway hits it.
+const float peerRequestRate = 800.0f;
+const float peerRequestBurst = 1700.0f;
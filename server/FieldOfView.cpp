@@ -0,0 +1,168 @@
+#include "FieldOfView.hpp"
+
+#include <algorithm>
+
+#include "LevelMap.hpp"
+
+FieldOfView::FieldOfView()
+{
+
+}
+
+FieldOfView::~FieldOfView()
+{
+
+}
+
+bool FieldOfView::IsValid(const LevelMap& levelMap, int column, int row, int radius) const
+{
+    if (column != column_
+        || row != row_
+        || radius != radius_
+        || mapColumnCount_ != levelMap.GetColumnCount()
+        || mapRowCount_ != levelMap.GetRowCount())
+    {
+        return false;
+    }
+
+    // nothing changed anywhere, or only far enough not to matter
+    return revision_ == levelMap.GetRevision()
+           || areaRevision_ == levelMap.GetAreaRevision(column - radius
+                                                        , row - radius
+                                                        , column + radius
+                                                        , row + radius);
+}
+
+void FieldOfView::Compute(const LevelMap& levelMap, int column, int row, int radius)
+{
+    column_ = column;
+    row_ = row;
+    radius_ = radius;
+    mapColumnCount_ = levelMap.GetColumnCount();
+    mapRowCount_ = levelMap.GetRowCount();
+    revision_ = levelMap.GetRevision();
+    areaRevision_ = levelMap.GetAreaRevision(column - radius
+                                             , row - radius
+                                             , column + radius
+                                             , row + radius);
+
+    int side = 2 * radius + 1;
+    visible_.assign((side * side + 63) / 64, 0);
+
+    SetVisible_(column, row);
+
+    // transforms of the first octant onto the others
+    static const int octants[8][4] =
+    {
+        { 1,  0,  0,  1},
+        { 0,  1,  1,  0},
+        { 0, -1,  1,  0},
+        {-1,  0,  0,  1},
+        {-1,  0,  0, -1},
+        { 0, -1, -1,  0},
+        { 0,  1, -1,  0},
+        { 1,  0,  0, -1},
+    };
+
+    for (auto& octant : octants)
+    {
+        CastLight_(levelMap, 1, 1.0f, 0.0f, octant[0], octant[1], octant[2], octant[3]);
+    }
+}
+
+bool FieldOfView::IsVisible(int column, int row) const
+{
+    int x = column - column_ + radius_;
+    int y = row - row_ + radius_;
+    int side = 2 * radius_ + 1;
+
+    if (x < 0 || y < 0 || x >= side || y >= side)
+    {
+        return false;
+    }
+
+    int bit = y * side + x;
+    return (visible_[bit / 64] >> (bit % 64)) & 1;
+}
+
+void FieldOfView::CastLight_(const LevelMap& levelMap
+                             , int distance
+                             , float startSlope
+                             , float endSlope
+                             , int xx
+                             , int xy
+                             , int yx
+                             , int yy)
+{
+    if (startSlope < endSlope)
+    {
+        return;
+    }
+
+    float nextStartSlope = startSlope;
+
+    for (int j = distance; j <= radius_; j++)
+    {
+        bool blocked = false;
+
+        for (int dx = -j, dy = -j; dx <= 0; dx++)
+        {
+            // slopes of the cell's left and right edges
+            float leftSlope = (dx - 0.5f) / (dy + 0.5f);
+            float rightSlope = (dx + 0.5f) / (dy - 0.5f);
+
+            if (startSlope < rightSlope)
+            {
+                continue;
+            }
+            if (endSlope > leftSlope)
+            {
+                break;
+            }
+
+            int column = column_ + dx * xx + dy * xy;
+            int row = row_ + dx * yx + dy * yy;
+            bool opaque = levelMap.GetCell(column, row) == '#';
+
+            SetVisible_(column, row);
+
+            if (blocked)
+            {
+                if (opaque)
+                {
+                    nextStartSlope = rightSlope;
+                    continue;
+                }
+                blocked = false;
+                startSlope = nextStartSlope;
+            }
+            else if (opaque && j < radius_)
+            {
+                // the wall splits the light, scan past its near side first
+                blocked = true;
+                CastLight_(levelMap, j + 1, startSlope, leftSlope, xx, xy, yx, yy);
+                nextStartSlope = rightSlope;
+            }
+        }
+
+        if (blocked)
+        {
+            break;
+        }
+    }
+}
+
+void FieldOfView::SetVisible_(int column, int row)
+{
+    int x = column - column_ + radius_;
+    int y = row - row_ + radius_;
+    int side = 2 * radius_ + 1;
+
+    if (x < 0 || y < 0 || x >= side || y >= side)
+    {
+        return;
+    }
+
+    int bit = y * side + x;
+    visible_[bit / 64] |= static_cast<uint64_t>(1) << (bit % 64);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+class LevelMap;
+
+// Cells seen from the centre of a cell within a square of given radius,
+// found by recursive shadowcasting over the eight octants. Walls block
+// sight but are seen themselves. The result is a bitset over the square
+// and is kept until the origin moves or a cell around it changes.
+class FieldOfView
+{
+public:
+    FieldOfView();
+    virtual ~FieldOfView();
+
+    // true if the last computation still holds for the given origin
+    bool IsValid(const LevelMap& levelMap, int column, int row, int radius) const;
+    void Compute(const LevelMap& levelMap, int column, int row, int radius);
+
+    bool IsVisible(int column, int row) const;
+
+private:
+    void CastLight_(const LevelMap& levelMap
+                    , int distance
+                    , float startSlope
+                    , float endSlope
+                    , int xx
+                    , int xy
+                    , int yx
+                    , int yy);
+    void SetVisible_(int column, int row);
+
+    int column_ = 0;
+    int row_ = 0;
+    int radius_ = -1;
+    int mapColumnCount_ = 0;
+    int mapRowCount_ = 0;
+    unsigned revision_ = 0;
+    unsigned areaRevision_ = 0;
+
+    std::vector<uint64_t> visible_;
+};
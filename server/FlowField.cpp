@@ -0,0 +1,256 @@
+#include "FlowField.hpp"
+
+#include <limits>
+
+#include "LevelMap.hpp"
+
+static const int unreached = std::numeric_limits<int>::max();
+static const int noOwner = -1;
+
+FlowField::FlowField(const LevelMap& levelMap)
+    : levelMap_(levelMap)
+{
+
+}
+
+FlowField::~FlowField()
+{
+
+}
+
+int FlowField::GetMaxDistance() const
+{
+    return maxDistance_;
+}
+
+void FlowField::SetMaxDistance(int maxDistance)
+{
+    maxDistance_ = maxDistance;
+    Rebuild();
+}
+
+void FlowField::Update()
+{
+    if (revision_ != levelMap_.GetRevision()
+        || columnCount_ != levelMap_.GetColumnCount()
+        || rowCount_ != levelMap_.GetRowCount())
+    {
+        Rebuild();
+    }
+}
+
+void FlowField::Rebuild()
+{
+    revision_ = levelMap_.GetRevision();
+    columnCount_ = levelMap_.GetColumnCount();
+    rowCount_ = levelMap_.GetRowCount();
+
+    distance_.assign(columnCount_ * rowCount_, unreached);
+    owner_.assign(columnCount_ * rowCount_, noOwner);
+    buckets_.resize(maxDistance_ + 1);
+    sourceCellCounts_.clear();
+
+    for (auto& source : sources_)
+    {
+        int index = ToIndex_(source.second.first, source.second.second);
+        if (index != -1 && sourceCellCounts_[index]++ == 0)
+        {
+            distance_[index] = 0;
+            owner_[index] = index;
+            buckets_[0].push_back(index);
+        }
+    }
+
+    Propagate_();
+}
+
+void FlowField::SetSource(int id, int column, int row)
+{
+    auto it = sources_.find(id);
+    if (it != sources_.end())
+    {
+        if (it->second == std::make_pair(column, row))
+        {
+            return;
+        }
+        RemoveSource(id);
+    }
+
+    sources_[id] = std::make_pair(column, row);
+
+    int index = ToIndex_(column, row);
+    if (index != -1)
+    {
+        AddSourceCell_(index);
+    }
+}
+
+void FlowField::RemoveSource(int id)
+{
+    auto it = sources_.find(id);
+    if (it == sources_.end())
+    {
+        return;
+    }
+
+    int index = ToIndex_(it->second.first, it->second.second);
+    sources_.erase(it);
+
+    if (index != -1)
+    {
+        RemoveSourceCell_(index);
+    }
+}
+
+int FlowField::GetDistance(int column, int row) const
+{
+    int index = ToIndex_(column, row);
+    if (index == -1 || distance_[index] == unreached)
+    {
+        return -1;
+    }
+    return distance_[index];
+}
+
+EActorDirection FlowField::GetDirection(int column, int row) const
+{
+    int distance = GetDistance(column, row);
+    if (distance <= 0)
+    {
+        return EActorDirection::NONE;
+    }
+
+    static const EActorDirection directions[] =
+    {
+        EActorDirection::NORTH,
+        EActorDirection::EAST,
+        EActorDirection::SOUTH,
+        EActorDirection::WEST,
+    };
+
+    for (auto direction : directions)
+    {
+        auto& d = directionToVector[static_cast<unsigned>(direction)];
+        int neighbour = GetDistance(column + static_cast<int>(d.x), row + static_cast<int>(d.y));
+        if (neighbour != -1 && neighbour < distance)
+        {
+            return direction;
+        }
+    }
+
+    return EActorDirection::NONE;
+}
+
+int FlowField::ToIndex_(int column, int row) const
+{
+    if (column < 0
+        || row < 0
+        || column >= columnCount_
+        || row >= rowCount_
+        || levelMap_.GetCell(column, row) == '#')
+    {
+        return -1;
+    }
+    return row * columnCount_ + column;
+}
+
+void FlowField::AddSourceCell_(int index)
+{
+    if (sourceCellCounts_[index]++ > 0)
+    {
+        return;
+    }
+
+    // lowering only spreads while it improves on the current distances
+    distance_[index] = 0;
+    owner_[index] = index;
+    buckets_[0].push_back(index);
+    Propagate_();
+}
+
+void FlowField::RemoveSourceCell_(int index)
+{
+    auto it = sourceCellCounts_.find(index);
+    if (it == sourceCellCounts_.end() || --it->second > 0)
+    {
+        return;
+    }
+    sourceCellCounts_.erase(it);
+
+    // every cell measured from the removed source is reachable from it
+    // through cells of the same owner, wipe them all
+    cleared_.clear();
+    cleared_.push_back(index);
+    distance_[index] = unreached;
+    owner_[index] = noOwner;
+
+    for (size_t i = 0; i < cleared_.size(); i++)
+    {
+        int cell = cleared_[i];
+        int column = cell % columnCount_;
+        int row = cell / columnCount_;
+
+        for (unsigned j = 1; j < directionToVector.size(); j++)
+        {
+            auto& d = directionToVector[j];
+            int neighbour = ToIndex_(column + static_cast<int>(d.x), row + static_cast<int>(d.y));
+            if (neighbour != -1 && owner_[neighbour] == index)
+            {
+                distance_[neighbour] = unreached;
+                owner_[neighbour] = noOwner;
+                cleared_.push_back(neighbour);
+            }
+        }
+    }
+
+    // then refill them from the cells of other sources bordering the hole
+    for (int cell : cleared_)
+    {
+        int column = cell % columnCount_;
+        int row = cell / columnCount_;
+
+        for (unsigned j = 1; j < directionToVector.size(); j++)
+        {
+            auto& d = directionToVector[j];
+            int neighbour = ToIndex_(column + static_cast<int>(d.x), row + static_cast<int>(d.y));
+            if (neighbour != -1 && owner_[neighbour] != noOwner)
+            {
+                buckets_[distance_[neighbour]].push_back(neighbour);
+            }
+        }
+    }
+
+    Propagate_();
+}
+
+void FlowField::Propagate_()
+{
+    for (int distance = 0; distance < static_cast<int>(buckets_.size()); distance++)
+    {
+        auto& bucket = buckets_[distance];
+        for (size_t i = 0; i < bucket.size(); i++)
+        {
+            int cell = bucket[i];
+            if (distance_[cell] != distance || distance == maxDistance_)
+            {
+                continue;
+            }
+
+            int column = cell % columnCount_;
+            int row = cell / columnCount_;
+
+            for (unsigned j = 1; j < directionToVector.size(); j++)
+            {
+                auto& d = directionToVector[j];
+                int neighbour = ToIndex_(column + static_cast<int>(d.x), row + static_cast<int>(d.y));
+                if (neighbour != -1 && distance + 1 < distance_[neighbour])
+                {
+                    distance_[neighbour] = distance + 1;
+                    owner_[neighbour] = owner_[cell];
+                    buckets_[distance + 1].push_back(neighbour);
+                }
+            }
+        }
+        bucket.clear();
+    }
+}
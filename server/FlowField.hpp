@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+
+#include "Actor.hpp"
+
+class LevelMap;
+
+// Distance map toward the nearest source over walkable cells, shared by
+// every monster: the step toward the closest player is read off the four
+// neighbours of a monster's cell. Sources are added, moved and removed
+// incrementally, only the cells whose nearest source changes are touched.
+// Sources standing on the same cell share it and the cells it owns.
+class FlowField
+{
+public:
+    FlowField(const LevelMap& levelMap);
+    virtual ~FlowField();
+
+    // cells farther than this from every source stay unreached
+    int GetMaxDistance() const;
+    void SetMaxDistance(int maxDistance);
+
+    // recomputes everything from the current sources if the level map
+    // changed since the last build
+    void Update();
+    void Rebuild();
+
+    // adds the source or moves it to another cell
+    void SetSource(int id, int column, int row);
+    void RemoveSource(int id);
+
+    // -1 for cells no source reaches
+    int GetDistance(int column, int row) const;
+
+    // direction of the neighbour closer to the nearest source,
+    // NONE if unreached or standing on a source
+    EActorDirection GetDirection(int column, int row) const;
+
+private:
+    int ToIndex_(int column, int row) const;
+    void AddSourceCell_(int index);
+    void RemoveSourceCell_(int index);
+    void Propagate_();
+
+    const LevelMap& levelMap_;
+    unsigned revision_ = 0;
+    int maxDistance_ = 10;
+    int rowCount_ = 0;
+    int columnCount_ = 0;
+
+    std::vector<int> distance_;
+    // index of the source cell each cell's distance is measured from
+    std::vector<int> owner_;
+    std::unordered_map<int, std::pair<int, int>> sources_;
+    std::unordered_map<int, int> sourceCellCounts_;
+
+    // reused between updates, bucket per distance
+    std::vector<std::vector<int>> buckets_;
+    std::vector<int> cleared_;
+};
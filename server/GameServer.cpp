@@ -4,18 +4,48 @@
 #include <QJsonDocument>
 #include <QCryptographicHash>
 #include <QTime>
+#include <QDateTime>
 #include <QVariant>
 #include <QDebug>
 #include <QImage>
 #include <QPixmap>
 #include <QFile>
+#include <QThread>
+#include <QRunnable>
 
 #include "PermaStorage.hpp"
 #include "utils.hpp"
 
+namespace
+{
+    // a function run on a QThreadPool
+    class Task : public QRunnable
+    {
+    public:
+        Task(std::function<void ()> function)
+            : function_(function)
+        {
+
+        }
+
+    protected:
+        virtual void run()
+        {
+            function_();
+        }
+
+    private:
+        std::function<void ()> function_;
+    };
+}
+
 //==============================================================================
-GameServer::GameServer()
+GameServer::GameServer(int workerCount, bool pinWorkers)
     : levelMap_(64, 64)
+    , flowField_(levelMap_)
+    , regionMap_(regionSize_)
+    , jobs_(workerCount, pinWorkers)
+    , pathFinder_(levelMap_, jobs_)
 {
     QTime midnight(0, 0, 0);
     qsrand(midnight.secsTo(QTime::currentTime()));
@@ -27,19 +57,48 @@ GameServer::GameServer()
             , &GameServer::tick);
     timer_->setInterval(1000.0f / static_cast<float>(ticksPerSecond_));
 
+    storagePool_.setMaxThreadCount(storageThreadCount_);
+    // an expired thread would take its database connection along
+    storagePool_.setExpiryTimeout(-1);
+
     GenRandSmoothMap(levelMap_);
     levelMap_.ExportToImage("generated-level-map.png");
     LoadLevelFromImage_("level-map.png");
+    ResizeLayers_();
+    flowField_.SetMaxDistance(chaseDistance_);
     GenMonsters_();
+    GenItems_();
 }
 
 //==============================================================================
 GameServer::~GameServer()
 {
+    // nothing will run what is still queued, storage tasks
+    // finishing from now on are turned away too
+    std::vector<Command> commands;
+    {
+        QMutexLocker locker(&commandsMutex_);
+        acceptingCommands_ = false;
+        commands.swap(commands_);
+    }
+
+    for (auto& command : commands)
+    {
+        WriteResult_(command.response, EFEMPResult::BAD_ACTION);
+        command.done(command.response);
+    }
+
+    storagePool_.waitForDone();
+
     for (auto actor : actors_)
     {
         delete actor;
     }
+
+    for (auto& p : itemLayer_.GetItems())
+    {
+        delete p.second;
+    }
 }
 
 //==============================================================================
@@ -65,27 +124,127 @@ void GameServer::Stop()
 }
 
 //==============================================================================
-void GameServer::handleFEMPRequest(const QVariantMap& request, QVariantMap& response)
+void GameServer::handleFEMPRequest(const QVariantMap& request, const QString& peer, FEMPCallback done)
 {
+    QVariantMap response;
     response["action"] = request["action"];
 
+    // lets the client tell apart responses that come out of order
+    auto requestIdIt = request.find("requestId");
+    if (requestIdIt != request.end())
+    {
+        response["requestId"] = requestIdIt.value();
+    }
+
     auto actionIt = request.find("action");
     if (actionIt == request.end())
     {
         WriteResult_(response, EFEMPResult::BAD_ACTION);
+        done(response);
         return;
     }
 
     QString action = actionIt.value().toString();
 //    qDebug() << "FEMP action: " << action;
+    auto storageIt = storageHandlers_.find(action);
     auto handlerIt = requestHandlers_.find(action);
 
-    if (handlerIt == requestHandlers_.end())
+    if (storageIt == storageHandlers_.end()
+        && handlerIt == requestHandlers_.end())
     {
         WriteResult_(response, EFEMPResult::BAD_ACTION);
+        done(response);
+        return;
+    }
+
+    auto actionClass = storageIt != storageHandlers_.end()
+                       ? storageIt.value().actionClass
+                       : handlerIt.value().actionClass;
+    if (!Admit_(request, peer, actionClass))
+    {
+        WriteResult_(response, EFEMPResult::RATE_LIMITED);
+        done(response);
+        return;
+    }
+
+    if (storageIt == storageHandlers_.end())
+    {
+        PostCommand_(request, response, done);
         return;
     }
 
+    // a slow query holds up neither the tick nor the connection
+    auto storageHandler = storageIt.value().handler;
+    bool simulated = handlerIt != requestHandlers_.end();
+    storagePool_.start(new Task([this, storageHandler, simulated, request, response, done]() mutable
+    {
+        (this->*storageHandler)(request, response);
+
+        if (simulated && response.find("result") == response.end())
+        {
+            PostCommand_(request, response, done);
+        }
+        else
+        {
+            Finish_(response, done);
+        }
+    }));
+}
+
+//==============================================================================
+void GameServer::runCommands()
+{
+    std::vector<Command> commands;
+    {
+        QMutexLocker locker(&commandsMutex_);
+        commands.swap(commands_);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for (auto& command : commands)
+    {
+        ExecuteRequest_(command.request, command.response);
+        Finish_(command.response, command.done);
+    }
+
+    busyTime_ += timer.nsecsElapsed();
+}
+
+//==============================================================================
+void GameServer::PostCommand_(const QVariantMap& request, const QVariantMap& response, const FEMPCallback& done)
+{
+    EFEMPResult result = EFEMPResult::BAD_ACTION;
+    {
+        QMutexLocker locker(&commandsMutex_);
+        // the simulation is that far behind, waiting won't help it
+        if (commands_.size() >= maxQueuedCommands_)
+        {
+            result = EFEMPResult::RATE_LIMITED;
+        }
+        else if (acceptingCommands_)
+        {
+            // one posted call runs everything queued up until it comes
+            commands_.push_back(Command{request, response, done});
+            if (commands_.size() == 1)
+            {
+                QMetaObject::invokeMethod(this, "runCommands", Qt::QueuedConnection);
+            }
+            return;
+        }
+    }
+
+    QVariantMap rejected = response;
+    WriteResult_(rejected, result);
+    done(rejected);
+}
+
+//==============================================================================
+void GameServer::ExecuteRequest_(const QVariantMap& request, QVariantMap& response)
+{
+    QString action = request["action"].toString();
+
     // TODO: extract into unordered_map
     if (sidCheckExcpetions_.count(action.toStdString()) == 0)
     {
@@ -97,13 +256,82 @@ void GameServer::handleFEMPRequest(const QVariantMap& request, QVariantMap& resp
         }
     }
 
-    auto handler = handlerIt.value();
+    auto handler = requestHandlers_[action].handler;
     (this->*handler)(request, response);
+}
+
+//==============================================================================
+bool GameServer::Admit_(const QVariantMap& request, const QString& peer, EActionClass actionClass)
+{
+    const ActionLimits& limits = actionLimits_[static_cast<unsigned>(actionClass)];
+
+    if (limits.sheddable && overloaded_.load())
+    {
+        return false;
+    }
+
+    // buckets per class, a client looking too much can still move
+    QByteArray classKey = QByteArray::number(static_cast<int>(actionClass));
+
+    if (!limiter_.Take("peer:" + classKey + ":" + peer.toLatin1(), limits.perPeer))
+    {
+        return false;
+    }
 
+    auto sidIt = request.find("sid");
+    if (sidIt != request.end()
+        && !limiter_.Take("sid:" + classKey + ":" + sidIt.value().toByteArray(), limits.perSid))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+void GameServer::UpdateLoad_()
+{
+    float budget = 1000000000.0f / ticksPerSecond_;
+    float load = busyTime_ / budget;
+    busyTime_ = 0;
+    load_ += (load - load_) * loadSmoothing_;
+
+    if (!overloaded_.load() && load_ >= maxLoad_)
+    {
+        overloaded_.store(1);
+        qDebug() << "Tick overrun, shedding requests, load:" << load_;
+    }
+    else if (overloaded_.load() && load_ < resumeLoad_)
+    {
+        overloaded_.store(0);
+        qDebug() << "Admitting all requests again, load:" << load_;
+    }
+}
+
+//==============================================================================
+void GameServer::Finish_(QVariantMap& response, const FEMPCallback& done)
+{
     if (response.find("result") == response.end())
     {
         WriteResult_(response, EFEMPResult::OK);
     }
+    done(response);
+}
+
+//==============================================================================
+PermaStorage& GameServer::GetThreadStorage_()
+{
+    if (!threadStorage_.hasLocalData())
+    {
+        auto name = QString("femp-0x%1").arg((quintptr)QThread::currentThreadId(), 0, 16);
+        PermaStorage* storage = new PermaStorage(name);
+        storage->Connect();
+        threadStorage_.setLocalData(storage);
+
+        // salts come from qrand, seeded per thread
+        qsrand(static_cast<uint>(QDateTime::currentMSecsSinceEpoch() ^ (quintptr)QThread::currentThreadId()));
+    }
+    return *threadStorage_.localData();
 }
 
 //==============================================================================
@@ -123,7 +351,9 @@ void GameServer::HandleRegister_(const QVariantMap& request, QVariantMap& respon
         }
     }
 
-    if (storage_.IfLoginPresent(login))
+    PermaStorage& storage = GetThreadStorage_();
+
+    if (storage.IfLoginPresent(login))
     {
         WriteResult_(response, EFEMPResult::LOGIN_EXISTS);
     }
@@ -142,7 +372,12 @@ void GameServer::HandleRegister_(const QVariantMap& request, QVariantMap& respon
         QByteArray passwordWithSalt = password.toUtf8();
         passwordWithSalt.append(salt);
         QByteArray hash = QCryptographicHash::hash(passwordWithSalt, QCryptographicHash::Sha3_256);
-        storage_.AddUser(login, QString(hash.toBase64()), QString(salt.toBase64()));
+        // a concurrent registration may have taken the login since the
+        // check above, the UNIQUE constraint rejects the second one
+        if (!storage.AddUser(login, QString(hash.toBase64()), QString(salt.toBase64())))
+        {
+            WriteResult_(response, EFEMPResult::LOGIN_EXISTS);
+        }
     }
 }
 
@@ -162,106 +397,205 @@ void GameServer::HandleDestroyItem_(const QVariantMap& request, QVariantMap& res
 
     BAD_ID(idToActor_.find(id) == idToActor_.end());
 
-    auto actor = idToActor_[id];
+    // only items lying within reach of the player
+    Item* item = itemLayer_.Get(id);
+    BAD_ID(item == NULL);
+
     Player* player = sidToPlayer_[request["sid"].toByteArray()];
+    auto d = item->GetPosition() - player->GetPosition();
+    BAD_ID(d.x * d.x + d.y * d.y > pickUpRadius_ * pickUpRadius_);
 
-    //    pickUpRadius_
-    // TODO: implement
+    KillItem_(item);
 
 #undef BAD_ID
 }
 
 //==============================================================================
-void GameServer::setWSAddress(QString address)
+void GameServer::HandlePickUp_(const QVariantMap& request, QVariantMap& response)
 {
-    wsAddress_ = address;
+    Player* player = sidToPlayer_[request["sid"].toByteArray()];
+    auto position = player->GetPosition();
+    Item* item = NULL;
+
+    if (request.find("id") != request.end())
+    {
+        item = itemLayer_.Get(request["id"].toInt());
+        if (item != NULL)
+        {
+            auto d = item->GetPosition() - position;
+            if (d.x * d.x + d.y * d.y > pickUpRadius_ * pickUpRadius_)
+            {
+                item = NULL;
+            }
+        }
+    }
+    else
+    {
+        // without an id the nearest item in reach
+        float nearest = pickUpRadius_ * pickUpRadius_;
+        itemLayer_.ForEachItemInRadius(position, pickUpRadius_, [&](Item* candidate)
+        {
+            auto d = candidate->GetPosition() - position;
+            if (d.x * d.x + d.y * d.y <= nearest)
+            {
+                nearest = d.x * d.x + d.y * d.y;
+                item = candidate;
+            }
+        });
+    }
+
+    if (item == NULL)
+    {
+        WriteResult_(response, EFEMPResult::BAD_ID);
+        return;
+    }
+
+    // the inventory has no room for the stack
+    if (!player->GetInventory().Add(item->GetTemplateId(), item->GetCount()))
+    {
+        WriteResult_(response, EFEMPResult::BAD_ACTION);
+        return;
+    }
+
+    response["id"] = item->GetId();
+    response["templateId"] = item->GetTemplateId();
+    response["count"] = item->GetCount();
+    KillItem_(item);
 }
 
 //==============================================================================
-void GameServer::tick()
+void GameServer::HandleDrop_(const QVariantMap& request, QVariantMap& response)
 {
-    float dt = (time_.elapsed() - lastTime_) * 0.001f;
-    lastTime_ = time_.elapsed();
+    if (request.find("templateId") == request.end())
+    {
+        WriteResult_(response, EFEMPResult::BAD_ID);
+        return;
+    }
 
-    auto collideWithGrid = [=](Actor* actor)
+    Player* player = sidToPlayer_[request["sid"].toByteArray()];
+    int templateId = request["templateId"].toInt();
+    int count = request.contains("count")
+                ? request["count"].toInt()
+                : player->GetInventory().GetCount(templateId);
+
+    if (count <= 0 || !player->GetInventory().Remove(templateId, count))
     {
-        auto& p = *actor;
+        WriteResult_(response, EFEMPResult::BAD_ID);
+        return;
+    }
 
-        float x = p.GetPosition().x;
-        float y = p.GetPosition().y;
+    Item* item = DropItem_(templateId, count, player->GetPosition(), true);
+    response["id"] = item->GetId();
+}
 
-        bool collided = false;
+//==============================================================================
+void GameServer::setWSAddress(QString address)
+{
+    wsAddress_ = address;
+}
 
-        if (levelMap_.GetCell(x + 0.5f, y) == '#')
-        {
-            p.SetPosition(Vector2(truncf(x + 0.5f) - 0.5f, p.GetPosition().y));
-            collided = true;
-        }
+//==============================================================================
+void GameServer::tick()
+{
+    QElapsedTimer timer;
+    timer.start();
 
-        if (levelMap_.GetCell(x - 0.5f, y) == '#')
-        {
-            p.SetPosition(Vector2(round(x - 0.5f) + 0.5f, p.GetPosition().y));
-            collided = true;
-        }
+    float dt = (time_.elapsed() - lastTime_) * 0.001f;
+    lastTime_ = time_.elapsed();
 
-        if (levelMap_.GetCell(x, y + 0.5f) == '#')
+    // labels are read by path jobs, they are only ever refreshed here
+    // and by whatever changes the cells
+    levelMap_.UpdateComponents();
+    timers_.Advance(tick_);
+    DespawnItems_();
+    UpdateRegionActivity_();
+    UpdateFlowField_();
+    UpdatePaths_();
+
+    // integrate: every actor only touches itself and reads the map;
+    // reactions to walls may use shared state such as rand(), they wait
+    int actorCount = actors_.size();
+    moves_.resize(actorCount);
+    jobs_.ParallelFor(0, actorCount, actorGrainSize_, [&](int first, int last)
+    {
+        for (int i = first; i < last; i++)
         {
-            p.SetPosition(Vector2(p.GetPosition().x, round(y + 0.5f) - 0.5f));
-            collided = true;
+            moves_[i].start = actors_[i]->GetPosition();
+            moves_[i].collided = false;
+            moves_[i].moved = IntegrateActor_(actors_[i], dt, moves_[i].collided);
         }
+    });
 
-        if (levelMap_.GetCell(x, y - 0.5f) == '#')
+    // index: the grid is shared, moved actors are refiled one by one
+    // and those that hit a wall react in actor order
+    for (int i = 0; i < actorCount; i++)
+    {
+        if (moves_[i].moved)
         {
-            p.SetPosition(Vector2(p.GetPosition().x, round(y - 0.5f) + 0.5f));
-            collided = true;
+            levelMap_.MoveActor(actors_[i], moves_[i].start);
         }
-
-        if (collided)
+        if (moves_[i].collided)
         {
-            actor->OnCollideWorld();
+            actors_[i]->OnCollideWorld();
         }
-    };
+    }
 
-    for (Actor* actor : actors_)
+    // collide: contacts are found in parallel against the new index and
+    // reported afterwards, in actor order, as both sides react to them
+    contacts_.resize((actorCount + actorGrainSize_ - 1) / actorGrainSize_);
+    jobs_.ParallelFor(0, actorCount, actorGrainSize_, [&](int first, int last)
     {
-        auto v = directionToVector[static_cast<unsigned>(actor->GetDirection())]
-                 * playerVelocity_;
-
-        actor->SetVelocity(v);
-        levelMap_.RemoveActor(actor);
-        actor->Update(dt);
-
-        collideWithGrid(actor);
+        auto& contacts = contacts_[first / actorGrainSize_];
+        contacts.clear();
 
-        auto cells = actor->GetOccupiedCells();
-        for (auto p : cells)
+        for (int i = first; i < last; i++)
         {
-            auto neighbours = levelMap_.GetActors(p.first, p.second);
-            // TODO: repetition of neighbours
-            for (auto neighbour : neighbours)
+            if (!moves_[i].moved)
+            {
+                continue;
+            }
+
+            Actor* actor = actors_[i];
+            auto position = actor->GetPosition();
+            float half = actor->GetSize() * 0.5f;
+            Box box0(position, actor->GetSize(), actor->GetSize());
+            levelMap_.ForEachActorInCells(GridRound(position.x - half)
+                                          , GridRound(position.y - half)
+                                          , GridRound(position.x + half)
+                                          , GridRound(position.y + half)
+                                          , [&](Actor* neighbour)
             {
                 if (neighbour == actor)
                 {
-                    continue;
+                    return;
                 }
-                Box box0(actor->GetPosition(), actor->GetSize(), actor->GetSize());
                 Box box1(neighbour->GetPosition(), neighbour->GetSize(), neighbour->GetSize());
                 if (box0.Intersect(box1))
                 {
-                    actor->OnCollideActor(neighbour);
-                    neighbour->OnCollideActor(actor);
+                    contacts.push_back(std::make_pair(actor, neighbour));
                 }
-            }
+            });
         }
+    });
 
-
-        levelMap_.IndexActor(actor);
+    for (auto& contacts : contacts_)
+    {
+        for (auto& contact : contacts)
+        {
+            contact.first->OnCollideActor(contact.second);
+            contact.second->OnCollideActor(contact.first);
+        }
     }
 
+    // broadcast
     QVariantMap tickMessage;
     tickMessage["tick"] = tick_;
-    emit broadcastMessage(QString(QJsonDocument::fromVariant(tickMessage).toJson()));
+    emit broadcastMessage(QJsonDocument::fromVariant(tickMessage).toJson());
     tick_++;
+
+    // requests run between ticks count towards the next one
+    busyTime_ += timer.nsecsElapsed();
+    UpdateLoad_();
 }
 
 //==============================================================================
@@ -286,6 +620,7 @@ void GameServer::HandleSetUpMap_(const QVariantMap& request, QVariantMap& respon
 #define BAD_MAP(COND)\
     if (COND)\
     {\
+        levelMap_.UpdateComponents();\
         WriteResult_(response, EFEMPResult::BAD_MAP);\
         return;\
     }\
@@ -304,6 +639,7 @@ void GameServer::HandleSetUpMap_(const QVariantMap& request, QVariantMap& respon
     BAD_MAP(columnCount == 0);
 
     levelMap_.Resize(columnCount, rowCount);
+    ResizeLayers_();
 
     for (int i = 0; i < rowCount; i++)
     {
@@ -318,6 +654,8 @@ void GameServer::HandleSetUpMap_(const QVariantMap& request, QVariantMap& respon
         }
     }
 
+    levelMap_.UpdateComponents();
+
 #undef BAD_MAP
 }
 
@@ -334,19 +672,21 @@ void GameServer::HandleGetConst_(const QVariantMap& request, QVariantMap& respon
 }
 
 //==============================================================================
-void GameServer::HandleLogin_(const QVariantMap& request, QVariantMap& response)
+void GameServer::HandleLoginCredentials_(const QVariantMap& request, QVariantMap& response)
 {
     auto login = request["login"].toString();
     auto password = request["password"].toString();
 
-    if (!storage_.IfLoginPresent(login))
+    PermaStorage& storage = GetThreadStorage_();
+
+    if (!storage.IfLoginPresent(login))
     {
         WriteResult_(response, EFEMPResult::INVALID_CREDENTIALS);
         return;
     }
 
-    QByteArray salt = QByteArray::fromBase64(storage_.GetSalt(login).toLatin1());
-    QByteArray refPassHash = QByteArray::fromBase64(storage_.GetPassHash(login).toLatin1());
+    QByteArray salt = QByteArray::fromBase64(storage.GetSalt(login).toLatin1());
+    QByteArray refPassHash = QByteArray::fromBase64(storage.GetPassHash(login).toLatin1());
 
     QByteArray passwordWithSalt = password.toUtf8();
     passwordWithSalt.append(salt);
@@ -355,8 +695,13 @@ void GameServer::HandleLogin_(const QVariantMap& request, QVariantMap& response)
     if (passHash != refPassHash)
     {
         WriteResult_(response, EFEMPResult::INVALID_CREDENTIALS);
-        return;
     }
+}
+
+//==============================================================================
+void GameServer::HandleLogin_(const QVariantMap& request, QVariantMap& response)
+{
+    auto login = request["login"].toString();
 
     QByteArray sid;
 
@@ -385,6 +730,10 @@ void GameServer::HandleLogout_(const QVariantMap& request, QVariantMap& response
     Player* p = it.value();
     qDebug() << "Logging out, login: " << p->GetLogin();
     sidToPlayer_.erase(it);
+    flowField_.RemoveSource(p->GetId());
+    fieldsOfView_.erase(p->GetId());
+    // inventories aren't stored, what was carried is left behind
+    DropInventory_(p);
     KillActor_(p);
 }
 
@@ -441,6 +790,31 @@ void GameServer::HandleMove_(const QVariantMap& request, QVariantMap& response)
     Player* p = sidToPlayer_[sid];
     p->SetDirection(direction);
     p->SetClientTick(tick);
+    p->SetPath(Path());
+    p->SetPathRequestId(0);
+}
+
+//==============================================================================
+void GameServer::HandleMoveTo_(const QVariantMap& request, QVariantMap& response)
+{
+    Q_UNUSED(response);
+
+    auto sid = request["sid"].toByteArray();
+    float x = request["x"].toFloat();
+    float y = request["y"].toFloat();
+
+    Player* p = sidToPlayer_[sid];
+    auto pos = p->GetPosition();
+
+    // the search runs in the background, the player
+    // sets off once UpdatePaths_ picks the path up
+    int requestId = pathFinder_.Request(GridRound(pos.x)
+                                        , GridRound(pos.y)
+                                        , GridRound(x)
+                                        , GridRound(y));
+    pathRequests_[requestId] = p->GetId();
+    p->SetPath(Path());
+    p->SetPathRequestId(requestId);
 }
 
 //==============================================================================
@@ -467,8 +841,7 @@ void GameServer::HandleLook_(const QVariantMap& request, QVariantMap& response)
     int minY = y - yDelta;
     int maxY = y + yDelta;
 
-    QVariantList actors;
-    std::unordered_set<Actor*> actorsInArea;
+    auto& fov = GetFieldOfView_(p, std::max(xDelta, yDelta));
 
     for (int j = minY; j <= maxY; j++)
     {
@@ -476,26 +849,48 @@ void GameServer::HandleLook_(const QVariantMap& request, QVariantMap& response)
         for (int i = minX; i <= maxX; i++)
         {
             row.push_back(QString(levelMap_.GetCell(i, j)));
+        }
+        rows.push_back(row);
+    }
 
-            auto& actorsInCell = levelMap_.GetActors(i, j);
-            for (auto& a : actorsInCell)
+    QVariantList actors;
+    levelMap_.ForEachActorInCells(minX, minY, maxX, maxY, [&](Actor* a)
+    {
+        // seen if any cell it stands in is
+        auto position = a->GetPosition();
+        float half = a->GetSize() * 0.5f;
+        bool visible = false;
+        for (int j = GridRound(position.y - half); j <= GridRound(position.y + half) && !visible; j++)
+        {
+            for (int i = GridRound(position.x - half); i <= GridRound(position.x + half) && !visible; i++)
             {
-                actorsInArea.insert(a);
+                visible = fov.IsVisible(i, j);
             }
         }
-        rows.push_back(row);
-    }
 
+        if (visible)
+        {
+            QVariantMap actor;
+            actor["type"] = a->GetType();
+            actor["x"] = a->GetPosition().x;
+            actor["y"] = a->GetPosition().y;
+            actor["id"] = a->GetId();
+            actors << actor;
+        }
+    });
 
-    for (auto& a : actorsInArea)
+    itemLayer_.ForEachItemInCells(minX, minY, maxX, maxY, [&](Item* item)
     {
-        QVariantMap actor;
-        actor["type"] = a->GetType();
-        actor["x"] = a->GetPosition().x;
-        actor["y"] = a->GetPosition().y;
-        actor["id"] = a->GetId();
-        actors << actor;
-    }
+        if (fov.IsVisible(GridRound(item->GetPosition().x), GridRound(item->GetPosition().y)))
+        {
+            QVariantMap actor;
+            actor["type"] = item->GetType();
+            actor["x"] = item->GetPosition().x;
+            actor["y"] = item->GetPosition().y;
+            actor["id"] = item->GetId();
+            actors << actor;
+        }
+    });
 
     response["map"] = rows;
     response["actors"] = actors;
@@ -523,6 +918,29 @@ void GameServer::HandleExamine_(const QVariantMap& request, QVariantMap& respons
     {
         response["login"] = p->GetLogin();
     }
+
+    Creature* c = dynamic_cast<Creature*>(actor);
+    if (c != NULL)
+    {
+        QVariantList items;
+        const Inventory& inventory = c->GetInventory();
+        for (int i = 0; i < inventory.GetSlotCount(); i++)
+        {
+            const Inventory::Slot& slot = inventory.GetSlot(i);
+            QVariantMap item;
+            item["templateId"] = slot.templateId;
+            item["count"] = slot.count;
+            items.push_back(item);
+        }
+        response["inventory"] = items;
+    }
+
+    Item* item = dynamic_cast<Item*>(actor);
+    if (item != NULL)
+    {
+        response["templateId"] = item->GetTemplateId();
+        response["count"] = item->GetCount();
+    }
 }
 
 //==============================================================================
@@ -540,6 +958,7 @@ void GameServer::LoadLevelFromImage_(const QString filename)
         QImage map;
         map.load(filename, "png");
         levelMap_.Resize(map.width(), map.height());
+        ResizeLayers_();
         for (int i = 0; i < map.height(); i++)
         {
             for (int j = 0; j < map.width(); j++)
@@ -551,17 +970,28 @@ void GameServer::LoadLevelFromImage_(const QString filename)
             }
         }
     }
+
+    // the random map is labeled here as well when there is no image
+    levelMap_.UpdateComponents();
 }
 
 //==============================================================================
 void GameServer::GenMonsters_()
 {
+    // monsters sealed off in pockets nobody can reach are wasted
+    int mainComponent = levelMap_.GetMainComponent();
+    // -1 is also what walls report, a map without floor gets no monsters
+    if (mainComponent == -1)
+    {
+        return;
+    }
+
     int monsterCounter = 0;
     for (int i = 0; i < levelMap_.GetRowCount(); i++)
     {
         for (int j = 0; j < levelMap_.GetColumnCount(); j++)
         {
-            if (levelMap_.GetCell(j, i) != '#')
+            if (levelMap_.GetComponent(j, i) == mainComponent)
             {
                 monsterCounter++;
                 if (monsterCounter % 5 == 0)
@@ -570,6 +1000,34 @@ void GameServer::GenMonsters_()
                     Monster& m = *monster;
                     SetActorPosition_(monster, Vector2(j + 0.5f, i + 0.5f));
                     m.SetDirection(static_cast<EActorDirection>(rand() % 4 + 1));
+                    m.GetInventory().Add(rand() % itemTemplateCount_, rand() % 3 + 1);
+                    ScheduleWander_(m.GetId());
+                }
+            }
+        }
+    }
+}
+
+//==============================================================================
+void GameServer::GenItems_()
+{
+    int mainComponent = levelMap_.GetMainComponent();
+    if (mainComponent == -1)
+    {
+        return;
+    }
+
+    int itemCounter = 0;
+    for (int i = 0; i < levelMap_.GetRowCount(); i++)
+    {
+        for (int j = 0; j < levelMap_.GetColumnCount(); j++)
+        {
+            if (levelMap_.GetComponent(j, i) == mainComponent)
+            {
+                itemCounter++;
+                if (itemCounter % 17 == 0)
+                {
+                    DropItem_(rand() % itemTemplateCount_, 1, Vector2(j + 0.5f, i + 0.5f), false);
                 }
             }
         }
@@ -587,10 +1045,14 @@ Player* GameServer::CreatePlayer_(const QString login)
     int y = 0;
     int c = 0;
     int r = 0;
+    int mainComponent = levelMap_.GetMainComponent();
 
     while (true)
     {
-        if (levelMap_.GetCell(c, r) == '.')
+        // checking the cell too, mainComponent is -1 like walls on a map
+        // without floor
+        if (levelMap_.GetCell(c, r) == '.'
+            && levelMap_.GetComponent(c, r) == mainComponent)
         {
             x = c;
             y = r;
@@ -620,3 +1082,394 @@ void GameServer::SetActorPosition_(Actor* actor, const Vector2& position)
     actor->SetPosition(position);
     levelMap_.IndexActor(actor);
 }
+
+//==============================================================================
+bool GameServer::IntegrateActor_(Actor* actor, float dt, bool& collided)
+{
+    auto detail = regionMap_.GetDetail(actor->GetPosition().x, actor->GetPosition().y);
+    if (detail == ERegionDetail::DORMANT)
+    {
+        // resume from where it was, no catching up on wake
+        actor->SetPendingTime(0.0f);
+        return false;
+    }
+
+    // less detailed regions tick less often but with a bigger step,
+    // actors are staggered by id to spread the load over ticks
+    actor->SetPendingTime(std::min(actor->GetPendingTime() + dt, 1.0f));
+    if ((tick_ + actor->GetId()) % GetTickStride_(detail) != 0)
+    {
+        return false;
+    }
+    float actorDt = actor->GetPendingTime();
+    actor->SetPendingTime(0.0f);
+
+    Monster* monster = dynamic_cast<Monster*>(actor);
+    if (monster != NULL)
+    {
+        SteerMonster_(monster, actorDt);
+    }
+
+    Player* player = dynamic_cast<Player*>(actor);
+    if (player != NULL)
+    {
+        FollowPath_(player, actorDt);
+    }
+
+    auto v = directionToVector[static_cast<unsigned>(actor->GetDirection())]
+             * playerVelocity_;
+
+    actor->SetVelocity(v);
+
+    collided = MoveActor_(actor, actorDt);
+    return true;
+}
+
+//==============================================================================
+bool GameServer::MoveActor_(Actor* actor, float dt)
+{
+    // let the actor integrate itself, then sweep the resulting
+    // displacement against the grid so no step is long enough to tunnel
+    Vector2 start = actor->GetPosition();
+    actor->Update(dt);
+    Vector2 delta = actor->GetPosition() - start;
+
+    Vector2 position = start;
+    bool collided = false;
+
+    // a sweep that stops at a wall may slide into an opening once
+    for (int i = 0; i < 2 && delta != Const::Math::V2_ZERO; i++)
+    {
+        Vector2 normal;
+        float t = levelMap_.SweepBox(position, actor->GetSize(), delta, normal);
+        position += delta * t;
+        delta *= 1.0f - t;
+
+        if (t >= 1.0f)
+        {
+            break;
+        }
+
+        // snap onto the free lane if the blocking wall only
+        // covers less than slideThreshold_ of the actor's side
+        bool slid = false;
+        if (normal.x != 0.0f)
+        {
+            float laneY = GridRound(position.y) + 0.5f;
+            int column = GridRound(position.x - normal.x * (actor->GetSize() * 0.5f + 0.5f));
+            if (fabs(position.y - laneY) < slideThreshold_
+                && levelMap_.GetCell(column, GridRound(laneY)) != '#')
+            {
+                position.y = laneY;
+                delta.y = 0.0f;
+                slid = true;
+            }
+            else
+            {
+                delta.x = 0.0f;
+            }
+        }
+        else
+        {
+            float laneX = GridRound(position.x) + 0.5f;
+            int row = GridRound(position.y - normal.y * (actor->GetSize() * 0.5f + 0.5f));
+            if (fabs(position.x - laneX) < slideThreshold_
+                && levelMap_.GetCell(GridRound(laneX), row) != '#')
+            {
+                position.x = laneX;
+                delta.x = 0.0f;
+                slid = true;
+            }
+            else
+            {
+                delta.y = 0.0f;
+            }
+        }
+
+        if (!slid)
+        {
+            collided = true;
+        }
+    }
+
+    actor->SetPosition(position);
+    return collided;
+}
+
+//==============================================================================
+void GameServer::SteerMonster_(Monster* monster, float dt)
+{
+    auto pos = monster->GetPosition();
+    int column = GridRound(pos.x);
+    int row = GridRound(pos.y);
+
+    auto direction = flowField_.GetDirection(column, row);
+    auto current = monster->GetDirection();
+    if (direction == EActorDirection::NONE || direction == current)
+    {
+        return;
+    }
+
+    auto& desired = directionToVector[static_cast<unsigned>(direction)];
+    auto& moving = directionToVector[static_cast<unsigned>(current)];
+
+    // turning back is always possible, turning aside only once the
+    // monster reaches its cell's centre so it fits into the corridor
+    bool reversing = current != EActorDirection::NONE
+                     && desired + moving == Const::Math::V2_ZERO;
+    if (!reversing)
+    {
+        Vector2 center(column + 0.5f, row + 0.5f);
+        if (current != EActorDirection::NONE
+            && (center - pos).Length() > playerVelocity_ * dt + epsilon_)
+        {
+            return;
+        }
+        monster->SetPosition(center);
+    }
+
+    monster->SetDirection(direction);
+}
+
+//==============================================================================
+void GameServer::ScheduleWander_(int monsterId)
+{
+    // somewhere between half and one and a half of the wander time
+    float time = monsterWanderTime_ * (0.5f + (rand() % 100) * 0.01f);
+    unsigned delay = static_cast<unsigned>(time * ticksPerSecond_);
+    timers_.Schedule(delay, [this, monsterId]()
+    {
+        WanderMonster_(monsterId);
+    });
+}
+
+//==============================================================================
+void GameServer::WanderMonster_(int monsterId)
+{
+    auto it = idToActor_.find(monsterId);
+    if (it == idToActor_.end())
+    {
+        return;
+    }
+
+    Monster* monster = dynamic_cast<Monster*>(it->second);
+    auto pos = monster->GetPosition();
+
+    // monsters in reach of a player follow the flow field instead
+    if (flowField_.GetDistance(GridRound(pos.x), GridRound(pos.y)) == -1)
+    {
+        monster->SetDirection(static_cast<EActorDirection>(rand() % 4 + 1));
+    }
+
+    ScheduleWander_(monsterId);
+}
+
+//==============================================================================
+void GameServer::UpdateFlowField_()
+{
+    flowField_.Update();
+
+    for (auto player : sidToPlayer_)
+    {
+        auto pos = player->GetPosition();
+        flowField_.SetSource(player->GetId(), GridRound(pos.x), GridRound(pos.y));
+    }
+}
+
+//==============================================================================
+void GameServer::UpdatePaths_()
+{
+    std::vector<PathFinder::Result> results;
+    pathFinder_.TakeResults(results);
+
+    for (auto& result : results)
+    {
+        auto requestIt = pathRequests_.find(result.requestId);
+        if (requestIt == pathRequests_.end())
+        {
+            continue;
+        }
+
+        auto actorIt = idToActor_.find(requestIt->second);
+        pathRequests_.erase(requestIt);
+
+        if (actorIt == idToActor_.end())
+        {
+            continue;
+        }
+
+        // superseded by a later move or moveTo
+        Player* player = dynamic_cast<Player*>(actorIt->second);
+        if (player == NULL || player->GetPathRequestId() != result.requestId)
+        {
+            continue;
+        }
+
+        player->SetPathRequestId(0);
+        if (result.found)
+        {
+            player->SetPath(result.path);
+        }
+    }
+}
+
+//==============================================================================
+const FieldOfView& GameServer::GetFieldOfView_(Player* player, int radius)
+{
+    auto pos = player->GetPosition();
+    int column = GridRound(pos.x);
+    int row = GridRound(pos.y);
+
+    // standing still with nothing changed nearby, keep what was seen
+    auto& fov = fieldsOfView_[player->GetId()];
+    if (!fov.IsValid(levelMap_, column, row, radius))
+    {
+        fov.Compute(levelMap_, column, row, radius);
+    }
+    return fov;
+}
+
+//==============================================================================
+void GameServer::FollowPath_(Player* player, float dt)
+{
+    Path& path = player->GetPath();
+    if (path.empty())
+    {
+        return;
+    }
+
+    auto pos = player->GetPosition();
+    Vector2 waypoint(path.front().first + 0.5f, path.front().second + 0.5f);
+    Vector2 offset = waypoint - pos;
+
+    if (offset.Length() <= playerVelocity_ * dt + epsilon_)
+    {
+        player->SetPosition(waypoint);
+        path.erase(path.begin());
+        if (path.empty())
+        {
+            player->SetDirection(EActorDirection::NONE);
+            return;
+        }
+        pos = waypoint;
+        waypoint = Vector2(path.front().first + 0.5f, path.front().second + 0.5f);
+        offset = waypoint - pos;
+    }
+
+    // waypoints are turning points, the way to the next one is straight
+    if (fabs(offset.x) > fabs(offset.y))
+    {
+        player->SetDirection(offset.x > 0.0f ? EActorDirection::EAST : EActorDirection::WEST);
+    }
+    else
+    {
+        player->SetDirection(offset.y > 0.0f ? EActorDirection::SOUTH : EActorDirection::NORTH);
+    }
+}
+
+//==============================================================================
+void GameServer::ResizeLayers_()
+{
+    regionMap_.Resize(levelMap_.GetColumnCount(), levelMap_.GetRowCount());
+    itemLayer_.Resize(levelMap_.GetColumnCount(), levelMap_.GetRowCount());
+}
+
+//==============================================================================
+void GameServer::UpdateRegionActivity_()
+{
+    regionMap_.Clear();
+
+    for (auto player : sidToPlayer_)
+    {
+        auto pos = player->GetPosition();
+        regionMap_.Wake(pos.x, pos.y, activityRadius_, ERegionDetail::LOW);
+        regionMap_.Wake(pos.x, pos.y, reducedDetailRadius_, ERegionDetail::REDUCED);
+        regionMap_.Wake(pos.x, pos.y, fullDetailRadius_, ERegionDetail::FULL);
+    }
+}
+
+//==============================================================================
+int GameServer::GetTickStride_(ERegionDetail detail) const
+{
+    switch (detail)
+    {
+    case ERegionDetail::REDUCED:
+        return std::max(reducedDetailTickDivisor_, 1);
+
+    case ERegionDetail::LOW:
+        // once a second
+        return std::max(ticksPerSecond_, 1);
+
+    default:
+        return 1;
+    }
+}
+
+//==============================================================================
+void GameServer::DespawnItems_()
+{
+    expiredItems_.clear();
+    itemLayer_.TakeExpired(tick_, expiredItems_);
+
+    for (Item* item : expiredItems_)
+    {
+        // already out of the layer
+        idToActor_.erase(item->GetId());
+        delete item;
+    }
+    expiredItems_.clear();
+}
+
+//==============================================================================
+Item* GameServer::DropItem_(int templateId, int count, const Vector2& position, bool despawn)
+{
+    unsigned despawnTick = 0;
+    if (despawn)
+    {
+        despawnTick = tick_ + static_cast<unsigned>(itemDespawnTime_ * ticksPerSecond_);
+    }
+
+    Item* item = itemLayer_.FindStack(GridRound(position.x), GridRound(position.y), templateId, despawn);
+    if (item != NULL)
+    {
+        item->SetCount(item->GetCount() + count);
+        // a fresh drop keeps the whole stack around a while longer
+        if (despawn)
+        {
+            itemLayer_.SetDespawnTick(item, despawnTick);
+        }
+        return item;
+    }
+
+    item = new Item();
+    item->SetId(lastId_);
+    lastId_++;
+    item->SetTemplateId(templateId);
+    item->SetCount(count);
+    item->SetPosition(position);
+    item->SetDespawnTick(despawnTick);
+    idToActor_[item->GetId()] = item;
+    itemLayer_.Add(item);
+    return item;
+}
+
+//==============================================================================
+void GameServer::KillItem_(Item*& item)
+{
+    idToActor_.erase(item->GetId());
+    itemLayer_.Remove(item);
+    delete item;
+    item = NULL;
+}
+
+//==============================================================================
+void GameServer::DropInventory_(Creature* creature)
+{
+    Inventory& inventory = creature->GetInventory();
+    for (int i = 0; i < inventory.GetSlotCount(); i++)
+    {
+        const Inventory::Slot& slot = inventory.GetSlot(i);
+        DropItem_(slot.templateId, slot.count, creature->GetPosition(), true);
+    }
+    inventory.Clear();
+}
@@ -7,11 +7,25 @@
 #include <QVariantMap>
 #include <QTimer>
 #include <QTime>
+#include <QMutex>
+#include <QThreadPool>
+#include <QThreadStorage>
+#include <QAtomicInt>
+#include <QElapsedTimer>
 
 #include "LevelMap.hpp"
+#include "RegionMap.hpp"
+#include "FlowField.hpp"
+#include "FieldOfView.hpp"
+#include "ItemLayer.hpp"
+#include "TimerWheel.hpp"
+#include "JobSystem.hpp"
+#include "PathFinder.hpp"
 #include "PermaStorage.hpp"
 #include "Player.hpp"
 #include "Monster.hpp"
+#include "FEMP.hpp"
+#include "RateLimiter.hpp"
 
 enum class EFEMPResult
 {
@@ -24,6 +38,8 @@ enum class EFEMPResult
     BAD_ID,
     BAD_ACTION,
     BAD_MAP,
+    // the client's limits ran out or the server sheds load, try later
+    RATE_LIMITED,
 };
 
 const std::vector<QString> fempResultToString =
@@ -37,6 +53,7 @@ const std::vector<QString> fempResultToString =
     [EFEMPResult::BAD_ID] = "badId",
     [EFEMPResult::BAD_ACTION] = "badAction",
     [EFEMPResult::BAD_MAP] = "badMap",
+    [EFEMPResult::RATE_LIMITED] = "rateLimited",
 };
 
 // TODO: separate module
@@ -46,42 +63,98 @@ class GameServer : public QObject
     Q_OBJECT
 
 signals:
-    void broadcastMessage(QString message);
+    void broadcastMessage(QByteArray message);
 
 public:
-    GameServer();
+    // 0 workers for one per core besides the simulation thread
+    GameServer(int workerCount = 0, bool pinWorkers = false);
     virtual ~GameServer();
 
     bool Start();
     void Stop();
 
 public slots:
-    void handleFEMPRequest(const QVariantMap& request, QVariantMap& response);
+    // safe to call from any thread, done is called once the response is
+    // ready, requests finish in no particular order; peer is the
+    // client's address
+    void handleFEMPRequest(const QVariantMap& request, const QString& peer, FEMPCallback done);
     void setWSAddress(QString address);
     void tick();
 
+private slots:
+    void runCommands();
+
 private:
 // Request Handlers
 //==============================================================================
     typedef void (GameServer::*HandlerType)(const QVariantMap& request, QVariantMap& response);
-    QMap<QString, HandlerType> requestHandlers_ =
+
+    // requests of a class share their rate limits
+    enum class EActionClass
+    {
+        TESTING,
+        AUTH,
+        QUERY,
+        MOVE,
+        INTERACT,
+    };
+
+    struct RequestHandler
+    {
+        HandlerType handler;
+        EActionClass actionClass;
+    };
+
+    // run on the storage threads, they only talk to the database,
+    // a result written here answers the request
+    const QMap<QString, RequestHandler> storageHandlers_ =
+    {
+        {"login", {&GameServer::HandleLoginCredentials_, EActionClass::AUTH}},
+        {"register", {&GameServer::HandleRegister_, EActionClass::AUTH}},
+    };
+
+    // run by the simulation between ticks
+    const QMap<QString, RequestHandler> requestHandlers_ =
     {
         // Testing
-        {"startTesting", &GameServer::HandleStartTesting_},
-        {"stopTesting", &GameServer::HandleStopTesting_},
-        {"setUpConst", &GameServer::HandleSetUpConstants_},
-        {"setUpMap", &GameServer::HandleSetUpMap_},
-        {"getConst", &GameServer::HandleGetConst_},
+        {"startTesting", {&GameServer::HandleStartTesting_, EActionClass::TESTING}},
+        {"stopTesting", {&GameServer::HandleStopTesting_, EActionClass::TESTING}},
+        {"setUpConst", {&GameServer::HandleSetUpConstants_, EActionClass::TESTING}},
+        {"setUpMap", {&GameServer::HandleSetUpMap_, EActionClass::TESTING}},
+        {"getConst", {&GameServer::HandleGetConst_, EActionClass::TESTING}},
         // Authorization
-        {"login", &GameServer::HandleLogin_},
-        {"logout", &GameServer::HandleLogout_},
-        {"register", &GameServer::HandleRegister_},
+        {"login", {&GameServer::HandleLogin_, EActionClass::AUTH}},
+        {"logout", {&GameServer::HandleLogout_, EActionClass::AUTH}},
         // Game Interaction
-        {"destroyItem", &GameServer::HandleDestroyItem_},
-        {"examine", &GameServer::HandleExamine_},
-        {"getDictionary", &GameServer::HandleGetDictionary_},
-        {"look", &GameServer::HandleLook_},
-        {"move", &GameServer::HandleMove_},
+        {"destroyItem", {&GameServer::HandleDestroyItem_, EActionClass::INTERACT}},
+        {"drop", {&GameServer::HandleDrop_, EActionClass::INTERACT}},
+        {"pickUp", {&GameServer::HandlePickUp_, EActionClass::INTERACT}},
+        {"examine", {&GameServer::HandleExamine_, EActionClass::QUERY}},
+        {"getDictionary", {&GameServer::HandleGetDictionary_, EActionClass::QUERY}},
+        {"look", {&GameServer::HandleLook_, EActionClass::QUERY}},
+        {"move", {&GameServer::HandleMove_, EActionClass::MOVE}},
+        {"moveTo", {&GameServer::HandleMoveTo_, EActionClass::MOVE}},
+    };
+
+    struct ActionLimits
+    {
+        RateLimiter::Limit perSid;
+        RateLimiter::Limit perPeer;
+        // turned away while the simulation can't keep up
+        bool sheddable;
+    };
+
+    // in the order of EActionClass; the client looks every frame and
+    // moves up to twice, a peer may be several players behind one address;
+    // logins are slow to refill against guessing but burst well past the
+    // registrations and logins of a client test suite run
+    const std::vector<ActionLimits> actionLimits_ =
+    {
+        {{0.0f, 0.0f}, {0.0f, 0.0f}, false},            // TESTING
+        {{0.0f, 0.0f}, {4.0f, 100.0f}, true},           // AUTH
+        {{60.0f, 120.0f}, {240.0f, 480.0f}, true},      // QUERY
+        {{120.0f, 240.0f}, {480.0f, 960.0f}, false},    // MOVE
+        {{10.0f, 20.0f}, {40.0f, 80.0f}, false},        // INTERACT
     };
 
     void HandleStartTesting_(const QVariantMap& request, QVariantMap& response);
@@ -90,23 +163,58 @@ private:
     void HandleSetUpMap_(const QVariantMap& request, QVariantMap& response);
     void HandleGetConst_(const QVariantMap& request, QVariantMap& response);
 
+    void HandleLoginCredentials_(const QVariantMap& request, QVariantMap& response);
     void HandleLogin_(const QVariantMap& request, QVariantMap& response);
     void HandleLogout_(const QVariantMap& request, QVariantMap& response);
     void HandleRegister_(const QVariantMap& request, QVariantMap& response);
 
     void HandleDestroyItem_(const QVariantMap& request, QVariantMap& response);
+    void HandleDrop_(const QVariantMap& request, QVariantMap& response);
+    void HandlePickUp_(const QVariantMap& request, QVariantMap& response);
     void HandleExamine_(const QVariantMap& request, QVariantMap& response);
     void HandleGetDictionary_(const QVariantMap& request, QVariantMap& response);
     void HandleLook_(const QVariantMap& request, QVariantMap& response);
     void HandleMove_(const QVariantMap& request, QVariantMap& response);
+    void HandleMoveTo_(const QVariantMap& request, QVariantMap& response);
 //==============================================================================
 
     void WriteResult_(QVariantMap& response, const EFEMPResult result);
 
+    // hands the request over to the simulation's thread
+    void PostCommand_(const QVariantMap& request, const QVariantMap& response, const FEMPCallback& done);
+    void ExecuteRequest_(const QVariantMap& request, QVariantMap& response);
+    void Finish_(QVariantMap& response, const FEMPCallback& done);
+    // false if the request is over its limits or shed
+    bool Admit_(const QVariantMap& request, const QString& peer, EActionClass actionClass);
+    void UpdateLoad_();
+    // the calling thread's own connection to the database
+    PermaStorage& GetThreadStorage_();
+
     void LoadLevelFromImage_(const QString filename);
     void GenMonsters_();
+    void GenItems_();
     Player* CreatePlayer_(const QString login);
     void SetActorPosition_(Actor* actor, const Vector2& position);
+    // both tell whether the actor hit a wall, for OnCollideWorld to be
+    // called later on the simulation thread
+    bool IntegrateActor_(Actor* actor, float dt, bool& collided);
+    bool MoveActor_(Actor* actor, float dt);
+    void SteerMonster_(Monster* monster, float dt);
+    void ScheduleWander_(int monsterId);
+    void WanderMonster_(int monsterId);
+    void UpdateFlowField_();
+    void UpdatePaths_();
+    void FollowPath_(Player* player, float dt);
+    const FieldOfView& GetFieldOfView_(Player* player, int radius);
+    void ResizeLayers_();
+    void UpdateRegionActivity_();
+    void DespawnItems_();
+    // stacks onto an item of the same template and lifetime lying there
+    Item* DropItem_(int templateId, int count, const Vector2& position, bool despawn);
+    void KillItem_(Item*& item);
+    // everything the creature carries goes to the ground, to despawn
+    void DropInventory_(Creature* creature);
+    int GetTickStride_(ERegionDetail detail) const;
 
     template <typename T>
     T* CreateActor_();
@@ -121,10 +229,49 @@ private:
     QMap<QByteArray, Player*> sidToPlayer_;
 
     LevelMap levelMap_;
+    ItemLayer itemLayer_;
+    // reused between ticks
+    std::vector<Item*> expiredItems_;
+    FlowField flowField_;
+    // player id -> what the player saw last time it looked
+    std::unordered_map<int, FieldOfView> fieldsOfView_;
 
     QString wsAddress_;
 
+    // schema and testing resets, used by the simulation's thread only
     PermaStorage storage_;
+    QThreadStorage<PermaStorage*> threadStorage_;
+    // logins and registrations wait for the database here, each
+    // thread keeping its connection open
+    QThreadPool storagePool_;
+    int storageThreadCount_ = 4;
+
+    // requests waiting for the simulation
+    struct Command
+    {
+        QVariantMap request;
+        QVariantMap response;
+        FEMPCallback done;
+    };
+    QMutex commandsMutex_;
+    std::vector<Command> commands_;
+    bool acceptingCommands_ = true;
+    // past this everything is turned away, whatever its class
+    size_t maxQueuedCommands_ = 4096;
+
+    RateLimiter limiter_;
+    // share of a tick's time the simulation spent working, smoothed;
+    // sheddable requests are turned away from when it reaches maxLoad_
+    // until it drops below resumeLoad_
+    qint64 busyTime_ = 0;
+    float load_ = 0.0f;
+    float loadSmoothing_ = 0.1f;
+    float maxLoad_ = 1.0f;
+    float resumeLoad_ = 0.8f;
+    QAtomicInt overloaded_;
+
+    // game events, advanced at the start of every tick
+    TimerWheel timers_;
 
     QTimer* timer_ = NULL;
     QTime time_;
@@ -138,6 +285,34 @@ private:
     int screenColumnCount_ = 9;
     float epsilon_ = 0.00001;
     float pickUpRadius_ = 1.5f;
+    float itemDespawnTime_ = 120.0f;
+    int itemTemplateCount_ = 8;
+    int regionSize_ = 16;
+    float fullDetailRadius_ = 12.0f;
+    float reducedDetailRadius_ = 24.0f;
+    float activityRadius_ = 40.0f;
+    int reducedDetailTickDivisor_ = 4;
+    int chaseDistance_ = 10;
+    float monsterWanderTime_ = 3.0f;
+    int actorGrainSize_ = 256;
+
+    // declared after the constants they are constructed from
+    RegionMap regionMap_;
+    JobSystem jobs_;
+    PathFinder pathFinder_;
+    // path request id -> id of the player waiting for it
+    std::unordered_map<int, int> pathRequests_;
+
+    // per actor results of the integrate phase of a tick
+    struct ActorMove
+    {
+        Vector2 start;
+        bool moved;
+        bool collided;
+    };
+    std::vector<ActorMove> moves_;
+    // contacts found by each chunk of the collide phase
+    std::vector<std::vector<std::pair<Actor*, Actor*>>> contacts_;
 
     bool testingStageActive_ = false;
 
@@ -0,0 +1,344 @@
+#include "HttpThread.hpp"
+
+#include <algorithm>
+
+#include <QJsonDocument>
+#include <QRegExp>
+#include <QUrlQuery>
+#include <QDebug>
+
+#include "qhttpserver.h"
+#include "qhttprequest.h"
+#include "qhttpresponse.h"
+
+#include "Server.hpp"
+#include "AssetCache.hpp"
+
+HttpWorker::HttpWorker(AssetCache* assets, RateLimiter* limiter)
+    : assets_(assets)
+    , limiter_(limiter)
+{
+    // back to the worker's thread
+    connect(this
+            , &HttpWorker::responseReady
+            , this
+            , &HttpWorker::sendResponse
+            , Qt::QueuedConnection);
+}
+
+HttpWorker::~HttpWorker()
+{
+    close();
+}
+
+bool HttpWorker::listen(quint16 port, bool reusePort)
+{
+    httpServer_ = new QHttpServer(this);
+    httpServer_->setReusePort(reusePort);
+
+    connect(httpServer_
+            , &QHttpServer::newRequest
+            , this
+            , &HttpWorker::handleRequest);
+
+    if (!httpServer_->listen(port))
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void HttpWorker::close()
+{
+    // takes the connections along
+    delete httpServer_;
+    httpServer_ = NULL;
+    pendingResponses_.clear();
+}
+
+void HttpWorker::handleRequest(QHttpRequest *request, QHttpResponse *response)
+{
+    auto method = request->method();
+
+    QString host = "";
+    QRegExp ipFromHost("(.*):.*");
+    host = request->header("host");
+    ipFromHost.indexIn(host);
+    host = ipFromHost.cap(1);
+
+    emit wsAddressChanged("ws://" + host + ":" + QString::number(Server::WS_PORT));
+
+    // connections are kept alive, their requests must not pile up
+    if (method != QHttpRequest::HTTP_POST)
+    {
+        connect(request
+                , &QHttpRequest::end
+                , request
+                , &QObject::deleteLater);
+    }
+
+    switch (method)
+    {
+        case QHttpRequest::HTTP_GET:
+        {
+            HandleAssetRequest_(request, response);
+        }
+            break;
+
+        case QHttpRequest::HTTP_POST:
+        {
+            // a flood is turned away before its body is even kept
+            if (!limiter_->Take(request->remoteAddress().toLatin1(), peerLimit_))
+            {
+                QByteArray body = "429 too many requests";
+                response->setHeader("Content-Length", QString::number(body.size()));
+                response->setHeader("Content-Type", "text/plain; charset=utf-8");
+                response->setHeader("Retry-After", "1");
+                response->writeHead(QHttpResponse::STATUS_TOO_MANY_REQUESTS);
+                response->end(body);
+                connect(request
+                        , &QHttpRequest::end
+                        , request
+                        , &QObject::deleteLater);
+                break;
+            }
+
+            // every request carries its own body and response,
+            // pipelined requests on a connection answer in order
+            request->storeBody();
+            connect(request
+                    , &QHttpRequest::end
+                    , this
+                    , [this, request, response]()
+            {
+                HandleFEMPRequest_(request, response);
+            });
+        }
+            break;
+
+        default:
+        {
+            QByteArray body;
+            body = "404 not found";
+            response->setHeader("Content-Length", QString::number(body.size()));
+            response->setHeader("Content-Type", "text/plain; charset=utf-8");
+            response->writeHead(QHttpResponse::STATUS_NOT_FOUND);
+            response->end(body);
+            qDebug() << "Unsupported HTTP method: " << method;
+        }
+    }
+}
+
+void HttpWorker::HandleFEMPRequest_(QHttpRequest* request, QHttpResponse* response)
+{
+    // gone with its connection
+    if (!request->successful())
+    {
+        request->deleteLater();
+        return;
+    }
+
+//    qDebug() << "request JSON: " << request->body();
+    QVariantMap requestMap = QJsonDocument::fromJson(request->body()).toVariant().toMap();
+    QString peer = request->remoteAddress();
+    request->deleteLater();
+
+    // the connection keeps parsing meanwhile, pipelined
+    // responses are still written in order
+    quint64 token = ++lastToken_;
+    pendingResponses_.insert(token, response);
+
+    emit newFEMPRequest(requestMap, peer, [this, token](const QVariantMap& responseMap)
+    {
+        emit responseReady(token, responseMap);
+    });
+}
+
+void HttpWorker::sendResponse(quint64 token, QVariantMap responseMap)
+{
+    // NULL if the connection went away in the meantime
+    QPointer<QHttpResponse> response = pendingResponses_.take(token);
+    if (response.isNull())
+    {
+        return;
+    }
+
+    auto responseJSON = QJsonDocument::fromVariant(responseMap).toJson();
+//    qDebug() << "response JSON: " << responseJSON;
+    response->setHeader("Access-Control-Allow-Origin", "*");
+    response->setHeader("Content-Type", "application/json; charset=utf-8");
+    // a known length keeps the connection alive for the next request
+    response->setHeader("Content-Length", QString::number(responseJSON.size()));
+    response->writeHead(QHttpResponse::STATUS_OK);
+    response->end(responseJSON);
+}
+
+void HttpWorker::HandleAssetRequest_(QHttpRequest* request, QHttpResponse* response)
+{
+    auto path = request->path();
+    if (path == "/")
+    {
+        path = "/index.html";
+    }
+    qDebug() << path;
+
+    response->setHeader("Access-Control-Allow-Origin", "*");
+
+    auto asset = assets_->Get(path);
+    if (!asset)
+    {
+        QByteArray body = "404 not found";
+        response->setHeader("Content-Length", QString::number(body.size()));
+        response->setHeader("Content-Type", "text/plain; charset=utf-8");
+        response->writeHead(QHttpResponse::STATUS_NOT_FOUND);
+        response->end(body);
+        return;
+    }
+
+    bool gzip = false;
+    if (!asset->gzipped.isEmpty())
+    {
+        for (auto coding : request->header("accept-encoding").split(','))
+        {
+            auto parts = coding.split(';');
+            if (parts[0].trimmed() == "gzip")
+            {
+                gzip = parts.size() < 2 || parts[1].remove(' ') != "q=0";
+            }
+        }
+    }
+
+    const QByteArray& body = gzip ? asset->gzipped : asset->data;
+    const QByteArray& etag = gzip ? asset->gzippedEtag : asset->etag;
+    // the length the full response would have, no body follows a 304
+    response->setHeader("Content-Length", QString::number(body.size()));
+    response->setHeader("ETag", etag);
+    response->setHeader("Vary", "Accept-Encoding");
+
+    // versioned urls never change, the rest is revalidated every time;
+    // a stale or made up version is just another unversioned request
+    if (QUrlQuery(request->url()).queryItemValue("v").toLatin1() == asset->version)
+    {
+        response->setHeader("Cache-Control", "public, max-age=31536000, immutable");
+    }
+    else
+    {
+        response->setHeader("Cache-Control", "no-cache");
+    }
+
+    // weak comparison, either variant's tag stands for the same content;
+    // no header, or a variant the asset doesn't have, matches nothing
+    for (auto tag : request->header("if-none-match").split(',', QString::SkipEmptyParts))
+    {
+        tag = tag.trimmed();
+        if (tag.startsWith("W/"))
+        {
+            tag = tag.mid(2);
+        }
+        if (tag.isEmpty())
+        {
+            continue;
+        }
+        if (tag == "*"
+            || tag == asset->etag
+            || (!asset->gzipped.isEmpty() && tag == asset->gzippedEtag))
+        {
+            response->writeHead(QHttpResponse::STATUS_NOT_MODIFIED);
+            response->end();
+            return;
+        }
+    }
+
+    response->setHeader("Content-Type", asset->contentType);
+    if (gzip)
+    {
+        response->setHeader("Content-Encoding", "gzip");
+    }
+    response->writeHead(QHttpResponse::STATUS_OK);
+    response->end(body);
+}
+
+HttpThreadPool::HttpThreadPool(AssetCache* assets, RateLimiter* limiter, int threadCount, QObject* parent)
+    : QObject(parent)
+{
+    if (!QHttpServer::reusePortSupported())
+    {
+        threadCount = 1;
+    }
+    else if (threadCount <= 0)
+    {
+        threadCount = std::max(QThread::idealThreadCount(), 1);
+    }
+
+    for (int i = 0; i < threadCount; i++)
+    {
+        QThread* thread = new QThread(this);
+        HttpWorker* worker = new HttpWorker(assets, limiter);
+        worker->moveToThread(thread);
+
+        connect(worker
+                , &HttpWorker::newFEMPRequest
+                , this
+                , &HttpThreadPool::newFEMPRequest
+                , Qt::DirectConnection);
+
+        connect(worker
+                , &HttpWorker::wsAddressChanged
+                , this
+                , &HttpThreadPool::wsAddressChanged
+                , Qt::DirectConnection);
+
+        thread->start();
+        threads_.push_back(thread);
+        workers_.push_back(worker);
+    }
+}
+
+HttpThreadPool::~HttpThreadPool()
+{
+    for (size_t i = 0; i < threads_.size(); i++)
+    {
+        threads_[i]->quit();
+        threads_[i]->wait();
+        // the thread is gone, nothing else can touch the worker
+        delete workers_[i];
+    }
+}
+
+int HttpThreadPool::GetThreadCount() const
+{
+    return threads_.size();
+}
+
+bool HttpThreadPool::Listen(quint16 port)
+{
+    bool reusePort = workers_.size() > 1;
+
+    // waiting is safe, a worker that isn't listening has no connections
+    // and so no request that could be waiting for the main thread
+    for (auto worker : workers_)
+    {
+        bool listening = false;
+        QMetaObject::invokeMethod(worker
+                                  , "listen"
+                                  , Qt::BlockingQueuedConnection
+                                  , Q_RETURN_ARG(bool, listening)
+                                  , Q_ARG(quint16, port)
+                                  , Q_ARG(bool, reusePort));
+        if (!listening)
+        {
+            Close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void HttpThreadPool::Close()
+{
+    for (auto worker : workers_)
+    {
+        QMetaObject::invokeMethod(worker, "close", Qt::QueuedConnection);
+    }
+}
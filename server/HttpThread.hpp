@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+
+#include <QObject>
+#include <QThread>
+#include <QVariantMap>
+#include <QHash>
+#include <QPointer>
+
+#include "qhttpserverfwd.h"
+
+#include "FEMP.hpp"
+#include "RateLimiter.hpp"
+
+class AssetCache;
+
+// Accepts and parses HTTP requests in the thread it lives in
+class HttpWorker : public QObject
+{
+    Q_OBJECT
+
+signals:
+    void newFEMPRequest(const QVariantMap& request, const QString& peer, FEMPCallback done);
+    void wsAddressChanged(QString address);
+    // emitted from whichever thread finished the request
+    void responseReady(quint64 token, QVariantMap response);
+
+public:
+    HttpWorker(AssetCache* assets, RateLimiter* limiter);
+    virtual ~HttpWorker();
+
+public slots:
+    // run in the worker's thread, the listener has to be created there
+    bool listen(quint16 port, bool reusePort);
+    void close();
+
+private slots:
+    void handleRequest(QHttpRequest* request, QHttpResponse* response);
+    void sendResponse(quint64 token, QVariantMap responseMap);
+
+private:
+    void HandleFEMPRequest_(QHttpRequest* request, QHttpResponse* response);
+    void HandleAssetRequest_(QHttpRequest* request, QHttpResponse* response);
+
+    QHttpServer* httpServer_ = NULL;
+    quint64 lastToken_ = 0;
+    QHash<quint64, QPointer<QHttpResponse>> pendingResponses_;
+    // shared by all the workers
+    AssetCache* assets_;
+    RateLimiter* limiter_;
+    RateLimiter::Limit peerLimit_ = {peerRequestRate, peerRequestBurst};
+};
+
+// Listener threads sharing the HTTP port through SO_REUSEPORT, the kernel
+// spreads connections between them. A single thread where the option is
+// not available, the main thread is left to the simulation either way.
+class HttpThreadPool : public QObject
+{
+    Q_OBJECT
+
+signals:
+    void newFEMPRequest(const QVariantMap& request, const QString& peer, FEMPCallback done);
+    void wsAddressChanged(QString address);
+
+public:
+    HttpThreadPool(AssetCache* assets, RateLimiter* limiter, int threadCount = 0, QObject* parent = NULL);
+    virtual ~HttpThreadPool();
+
+    int GetThreadCount() const;
+
+    bool Listen(quint16 port);
+    void Close();
+
+private:
+    std::vector<QThread*> threads_;
+    std::vector<HttpWorker*> workers_;
+};
@@ -0,0 +1,127 @@
+#include "Inventory.hpp"
+
+#include <limits>
+
+Inventory::Inventory()
+{
+
+}
+
+int Inventory::GetSlotCount() const
+{
+    return slotCount_;
+}
+
+const Inventory::Slot& Inventory::GetSlot(int index) const
+{
+    return slots_[index];
+}
+
+bool Inventory::Add(int templateId, int count, int affix)
+{
+    if (count <= 0)
+    {
+        return count == 0;
+    }
+
+    if (!Fits_(templateId, affix))
+    {
+        return false;
+    }
+
+    int index = Find_(templateId, affix);
+    if (index != -1)
+    {
+        if (slots_[index].count + count > std::numeric_limits<uint16_t>::max())
+        {
+            return false;
+        }
+        slots_[index].count += count;
+        return true;
+    }
+
+    if (slotCount_ == capacity
+        || count > std::numeric_limits<uint16_t>::max())
+    {
+        return false;
+    }
+
+    Slot& slot = slots_[slotCount_];
+    slot.templateId = templateId;
+    slot.affix = affix;
+    slot.count = count;
+    slotCount_++;
+    return true;
+}
+
+bool Inventory::Remove(int templateId, int count, int affix)
+{
+    if (count <= 0 || !Fits_(templateId, affix))
+    {
+        return false;
+    }
+
+    int index = Find_(templateId, affix);
+    if (index == -1 || slots_[index].count < count)
+    {
+        return false;
+    }
+
+    slots_[index].count -= count;
+    if (slots_[index].count == 0)
+    {
+        RemoveSlot(index);
+    }
+    return true;
+}
+
+void Inventory::RemoveSlot(int index)
+{
+    if (index < 0 || index >= slotCount_)
+    {
+        return;
+    }
+
+    for (int i = index; i + 1 < slotCount_; i++)
+    {
+        slots_[i] = slots_[i + 1];
+    }
+    slotCount_--;
+}
+
+void Inventory::Clear()
+{
+    slotCount_ = 0;
+}
+
+int Inventory::GetCount(int templateId, int affix) const
+{
+    if (!Fits_(templateId, affix))
+    {
+        return 0;
+    }
+
+    int index = Find_(templateId, affix);
+    return index == -1 ? 0 : slots_[index].count;
+}
+
+int Inventory::Find_(int templateId, int affix) const
+{
+    for (int i = 0; i < slotCount_; i++)
+    {
+        if (slots_[i].templateId == templateId
+            && slots_[i].affix == affix)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool Inventory::Fits_(int templateId, int affix)
+{
+    return templateId >= std::numeric_limits<int16_t>::min()
+           && templateId <= std::numeric_limits<int16_t>::max()
+           && affix >= std::numeric_limits<int16_t>::min()
+           && affix <= std::numeric_limits<int16_t>::max();
+}
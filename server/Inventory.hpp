@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+// Item stacks carried by a creature, kept by value in a fixed number of
+// inline slots so that picking up and dropping never touch the heap. Stacks of the same template and affix merge.
+class Inventory
+{
+public:
+    static const int capacity = 16;
+    static const int noAffix = -1;
+
+    struct Slot
+    {
+        int16_t templateId;
+        int16_t affix;
+        uint16_t count;
+    };
+
+    Inventory();
+
+    int GetSlotCount() const;
+    const Slot& GetSlot(int index) const;
+
+    // returns false and leaves the inventory as it was if the stack
+    // fits nowhere or templateId or affix don't fit a slot's int16_t
+    bool Add(int templateId, int count, int affix = noAffix);
+    // returns false if fewer than count are carried or count <= 0
+    bool Remove(int templateId, int count, int affix = noAffix);
+    // slots outside [0, GetSlotCount()) are ignored
+    void RemoveSlot(int index);
+    void Clear();
+
+    int GetCount(int templateId, int affix = noAffix) const;
+
+private:
+    int Find_(int templateId, int affix) const;
+    // whether the ids survive the narrowing into a slot
+    static bool Fits_(int templateId, int affix);
+
+    Slot slots_[capacity];
+    uint8_t slotCount_ = 0;
+};
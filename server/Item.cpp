@@ -9,3 +9,33 @@ Item::~Item()
 {
 
 }
+
+int Item::GetTemplateId() const
+{
+    return templateId_;
+}
+
+void Item::SetTemplateId(int templateId)
+{
+    templateId_ = templateId;
+}
+
+int Item::GetCount() const
+{
+    return count_;
+}
+
+void Item::SetCount(int count)
+{
+    count_ = count;
+}
+
+unsigned Item::GetDespawnTick() const
+{
+    return despawnTick_;
+}
+
+void Item::SetDespawnTick(unsigned despawnTick)
+{
+    despawnTick_ = despawnTick;
+}
@@ -8,5 +8,19 @@ public:
     Item();
     virtual ~Item();
 
+    // items of the same template lying on one cell stack into one
+    int GetTemplateId() const;
+    void SetTemplateId(int templateId);
+
+    int GetCount() const;
+    void SetCount(int count);
+
+    // tick the item disappears at, 0 if it stays
+    unsigned GetDespawnTick() const;
+    void SetDespawnTick(unsigned despawnTick);
+
 private:
+    int templateId_ = 0;
+    int count_ = 1;
+    unsigned despawnTick_ = 0;
 };
@@ -0,0 +1,173 @@
+#include "ItemLayer.hpp"
+
+#include "utils.hpp"
+
+ItemLayer::ItemLayer()
+{
+
+}
+
+ItemLayer::~ItemLayer()
+{
+
+}
+
+void ItemLayer::Resize(int columnCount, int rowCount)
+{
+    columnCount_ = columnCount;
+    rowCount_ = rowCount;
+    cells_.clear();
+    cells_.resize(columnCount_ * rowCount_);
+
+    // items left outside the new bounds stay, but no query finds them
+    for (auto& p : items_)
+    {
+        int index = ToIndex_(p.second);
+        if (index != -1)
+        {
+            cells_[index].push_back(p.second);
+        }
+    }
+}
+
+int ItemLayer::GetDespawnBucketTicks() const
+{
+    return despawnBucketTicks_;
+}
+
+void ItemLayer::SetDespawnBucketTicks(int despawnBucketTicks)
+{
+    // rebucket what is already scheduled
+    std::map<unsigned, std::vector<int>> despawns;
+    despawns.swap(despawns_);
+    despawnBucketTicks_ = std::max(despawnBucketTicks, 1);
+
+    for (auto& p : items_)
+    {
+        if (p.second->GetDespawnTick() != 0)
+        {
+            despawns_[ToBucket_(p.second->GetDespawnTick())].push_back(p.first);
+        }
+    }
+}
+
+void ItemLayer::Add(Item* item)
+{
+    items_[item->GetId()] = item;
+
+    int index = ToIndex_(item);
+    if (index != -1)
+    {
+        cells_[index].push_back(item);
+    }
+
+    if (item->GetDespawnTick() != 0)
+    {
+        despawns_[ToBucket_(item->GetDespawnTick())].push_back(item->GetId());
+    }
+}
+
+void ItemLayer::Remove(Item* item)
+{
+    items_.erase(item->GetId());
+
+    int index = ToIndex_(item);
+    if (index != -1)
+    {
+        auto& cell = cells_[index];
+        cell.erase(std::remove(cell.begin(), cell.end(), item), cell.end());
+    }
+}
+
+Item* ItemLayer::Get(int id) const
+{
+    auto it = items_.find(id);
+    return it == items_.end() ? NULL : it->second;
+}
+
+const std::unordered_map<int, Item*>& ItemLayer::GetItems() const
+{
+    return items_;
+}
+
+Item* ItemLayer::FindStack(int column, int row, int templateId, bool despawning) const
+{
+    int index = ToIndex_(column, row);
+    if (index == -1)
+    {
+        return NULL;
+    }
+
+    for (Item* item : cells_[index])
+    {
+        if (item->GetTemplateId() == templateId
+            && (item->GetDespawnTick() != 0) == despawning)
+        {
+            return item;
+        }
+    }
+    return NULL;
+}
+
+void ItemLayer::SetDespawnTick(Item* item, unsigned despawnTick)
+{
+    item->SetDespawnTick(despawnTick);
+    if (despawnTick != 0)
+    {
+        despawns_[ToBucket_(despawnTick)].push_back(item->GetId());
+    }
+}
+
+void ItemLayer::TakeExpired(unsigned tick, std::vector<Item*>& expired)
+{
+    while (!despawns_.empty()
+           && despawns_.begin()->first * despawnBucketTicks_ <= tick)
+    {
+        auto bucket = despawns_.begin();
+        for (int id : bucket->second)
+        {
+            Item* item = Get(id);
+            // gone or moved to another bucket since
+            if (item == NULL
+                || item->GetDespawnTick() == 0
+                || ToBucket_(item->GetDespawnTick()) != bucket->first)
+            {
+                continue;
+            }
+
+            // listed twice in the bucket if rescheduled within it
+            item->SetDespawnTick(0);
+            Remove(item);
+            expired.push_back(item);
+        }
+        despawns_.erase(bucket);
+    }
+}
+
+int ItemLayer::ToIndex_(int column, int row) const
+{
+    if (column < 0
+        || row < 0
+        || column >= columnCount_
+        || row >= rowCount_)
+    {
+        return -1;
+    }
+    return row * columnCount_ + column;
+}
+
+int ItemLayer::ToIndex_(const Item* item) const
+{
+    return ToIndex_(GridRound(item->GetPosition().x), GridRound(item->GetPosition().y));
+}
+
+int ItemLayer::ToCell_(float value) const
+{
+    return GridRound(value);
+}
+
+unsigned ItemLayer::ToBucket_(unsigned tick) const
+{
+    // rounded up, an item never goes before its time
+    return (tick + despawnBucketTicks_ - 1) / despawnBucketTicks_;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+#include "Item.hpp"
+
+// Items lying on the ground. They never move, so they are kept apart
+// from the simulated actors in a grid of their own and only touched when
+// dropped, picked up or despawned. Despawns are grouped into buckets of
+// ticks and expire a bucket at a time. The layer does not own its items.
+class ItemLayer
+{
+public:
+    ItemLayer();
+    virtual ~ItemLayer();
+
+    void Resize(int columnCount, int rowCount);
+
+    int GetDespawnBucketTicks() const;
+    void SetDespawnBucketTicks(int despawnBucketTicks);
+
+    void Add(Item* item);
+    void Remove(Item* item);
+
+    // NULL if no item with the id lies on the ground
+    Item* Get(int id) const;
+    const std::unordered_map<int, Item*>& GetItems() const;
+
+    // item of given template to stack onto, NULL if none lies on the cell;
+    // despawning and permanent stacks are kept apart, a merged stack
+    // could only have one lifetime
+    Item* FindStack(int column, int row, int templateId, bool despawning) const;
+
+    // 0 keeps the item forever, otherwise it expires with the bucket
+    // the tick falls into
+    void SetDespawnTick(Item* item, unsigned despawnTick);
+    // removes items whose bucket expired by tick and hands them over
+    void TakeExpired(unsigned tick, std::vector<Item*>& expired);
+
+    // f is called for every item lying on a cell of the range
+    template <typename F>
+    void ForEachItemInCells(int minColumn, int minRow, int maxColumn, int maxRow, F f) const;
+    // f is called for every item within radius of point
+    template <typename F>
+    void ForEachItemInRadius(const Deku2D::Vector2& point, float radius, F f) const;
+
+private:
+    int ToIndex_(int column, int row) const;
+    int ToIndex_(const Item* item) const;
+    int ToCell_(float value) const;
+    unsigned ToBucket_(unsigned tick) const;
+
+    int rowCount_ = 0;
+    int columnCount_ = 0;
+    int despawnBucketTicks_ = 60;
+
+    std::vector<std::vector<Item*>> cells_;
+    std::unordered_map<int, Item*> items_;
+    // ids of items to despawn by bucket, entries of items picked up
+    // or rescheduled meanwhile are skipped on expiry
+    std::map<unsigned, std::vector<int>> despawns_;
+};
+
+template <typename F>
+void ItemLayer::ForEachItemInCells(int minColumn, int minRow, int maxColumn, int maxRow, F f) const
+{
+    minColumn = std::max(minColumn, 0);
+    minRow = std::max(minRow, 0);
+    maxColumn = std::min(maxColumn, columnCount_ - 1);
+    maxRow = std::min(maxRow, rowCount_ - 1);
+
+    for (int i = minRow; i <= maxRow; i++)
+    {
+        for (int j = minColumn; j <= maxColumn; j++)
+        {
+            for (Item* item : cells_[i * columnCount_ + j])
+            {
+                f(item);
+            }
+        }
+    }
+}
+
+template <typename F>
+void ItemLayer::ForEachItemInRadius(const Deku2D::Vector2& point, float radius, F f) const
+{
+    float radiusSquared = radius * radius;
+    ForEachItemInCells(ToCell_(point.x - radius)
+                       , ToCell_(point.y - radius)
+                       , ToCell_(point.x + radius)
+                       , ToCell_(point.y + radius)
+                       , [&](Item* item)
+    {
+        auto d = item->GetPosition() - point;
+        if (d.x * d.x + d.y * d.y <= radiusSquared)
+        {
+            f(item);
+        }
+    });
+}
@@ -0,0 +1,229 @@
+#include "JobSystem.hpp"
+
+#include <algorithm>
+
+#include <QMutexLocker>
+#include <QThread>
+
+#ifdef Q_OS_LINUX
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace
+{
+    // queue of the running thread, the shared one for non workers
+    thread_local const JobSystem* currentSystem = NULL;
+    thread_local int currentQueue = -1;
+}
+
+//==============================================================================
+class JobSystem::Worker : public QThread
+{
+public:
+    Worker(JobSystem& system, int index, bool pin)
+        : system_(system)
+        , index_(index)
+        , pin_(pin)
+    {
+
+    }
+
+protected:
+    virtual void run()
+    {
+#ifdef Q_OS_LINUX
+        if (pin_)
+        {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(index_ % std::max(QThread::idealThreadCount(), 1), &cpus);
+            pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        }
+#endif
+        currentSystem = &system_;
+        currentQueue = index_;
+        system_.WorkerLoop_(index_);
+    }
+
+private:
+    JobSystem& system_;
+    int index_;
+    bool pin_;
+};
+
+//==============================================================================
+JobSystem::JobSystem(int workerCount, bool pinWorkers)
+{
+    if (workerCount <= 0)
+    {
+        workerCount = std::max(QThread::idealThreadCount() - 1, 1);
+    }
+
+    // one queue per worker and the shared one last
+    for (int i = 0; i <= workerCount; i++)
+    {
+        queues_.emplace_back(new Queue());
+    }
+
+    for (int i = 0; i < workerCount; i++)
+    {
+        workers_.emplace_back(new Worker(*this, i, pinWorkers));
+        workers_.back()->start();
+    }
+}
+
+//==============================================================================
+JobSystem::~JobSystem()
+{
+    {
+        QMutexLocker locker(&sleepMutex_);
+        stopping_ = true;
+        wake_.wakeAll();
+    }
+
+    for (auto& worker : workers_)
+    {
+        worker->wait();
+    }
+}
+
+//==============================================================================
+int JobSystem::GetWorkerCount() const
+{
+    return workers_.size();
+}
+
+//==============================================================================
+void JobSystem::Run(Job job, JobCounter* counter)
+{
+    Push_(*queues_[GetQueueIndex_()], std::move(job), counter);
+}
+
+//==============================================================================
+void JobSystem::RunBackground(Job job, JobCounter* counter)
+{
+    Push_(background_, std::move(job), counter);
+}
+
+//==============================================================================
+void JobSystem::Wait(JobCounter& counter)
+{
+    int queueIndex = GetQueueIndex_();
+    while (counter.pending_.load() > 0)
+    {
+        if (!RunOne_(queueIndex, false))
+        {
+            QThread::yieldCurrentThread();
+        }
+    }
+}
+
+//==============================================================================
+int JobSystem::GetQueueIndex_() const
+{
+    if (currentSystem == this)
+    {
+        return currentQueue;
+    }
+    return queues_.size() - 1;
+}
+
+//==============================================================================
+void JobSystem::Push_(Queue& queue, Job job, JobCounter* counter)
+{
+    if (counter != NULL)
+    {
+        counter->pending_++;
+    }
+
+    {
+        QMutexLocker locker(&queue.mutex);
+        queue.tasks.push_back(Task { std::move(job), counter });
+    }
+
+    // counted under the lock so a worker going to sleep cannot miss it
+    QMutexLocker locker(&sleepMutex_);
+    queued_++;
+    wake_.wakeOne();
+}
+
+//==============================================================================
+bool JobSystem::RunOne_(int queueIndex, bool background)
+{
+    Task task;
+    bool found = false;
+
+    // newest of our own first, it is the most likely still in cache
+    {
+        Queue& queue = *queues_[queueIndex];
+        QMutexLocker locker(&queue.mutex);
+        if (!queue.tasks.empty())
+        {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            found = true;
+        }
+    }
+
+    // then the oldest of someone else's
+    int queueCount = queues_.size();
+    for (int i = 1; i < queueCount && !found; i++)
+    {
+        Queue& queue = *queues_[(queueIndex + i) % queueCount];
+        QMutexLocker locker(&queue.mutex);
+        if (!queue.tasks.empty())
+        {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            found = true;
+        }
+    }
+
+    // background only once nothing else is left
+    if (!found && background)
+    {
+        QMutexLocker locker(&background_.mutex);
+        if (!background_.tasks.empty())
+        {
+            task = std::move(background_.tasks.front());
+            background_.tasks.pop_front();
+            found = true;
+        }
+    }
+
+    if (!found)
+    {
+        return false;
+    }
+
+    queued_--;
+    task.job();
+    if (task.counter != NULL)
+    {
+        task.counter->pending_--;
+    }
+    return true;
+}
+
+//==============================================================================
+void JobSystem::WorkerLoop_(int queueIndex)
+{
+    while (true)
+    {
+        if (RunOne_(queueIndex, true))
+        {
+            continue;
+        }
+
+        QMutexLocker locker(&sleepMutex_);
+        if (stopping_)
+        {
+            return;
+        }
+        if (queued_.load() == 0)
+        {
+            wake_.wait(&sleepMutex_);
+        }
+    }
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <QMutex>
+#include <QWaitCondition>
+
+// Jobs of a group still to finish, waited on with JobSystem::Wait
+class JobCounter
+{
+public:
+    int GetPending() const
+    {
+        return pending_.load();
+    }
+
+private:
+    friend class JobSystem;
+
+    std::atomic<int> pending_ { 0 };
+};
+
+// Work stealing scheduler shared by everything that runs in parallel.
+// Each worker keeps a queue of its own, takes its newest jobs first and
+// steals the oldest ones of the others when it runs dry. Threads that
+// are not workers push into a queue of their own the workers steal from,
+// and help with the jobs while waiting for a group to finish. Background
+// jobs go to a queue only the idle workers take from, a thread waiting
+// for its group never gets stuck running one of them.
+class JobSystem
+{
+public:
+    typedef std::function<void()> Job;
+
+    // 0 workers picks one per core besides the calling thread; pinned
+    // workers are each bound to a core of their own where supported
+    JobSystem(int workerCount = 0, bool pinWorkers = false);
+    virtual ~JobSystem();
+
+    int GetWorkerCount() const;
+
+    void Run(Job job, JobCounter* counter = NULL);
+    // for long jobs nobody waits on in a hurry, such as path searches
+    void RunBackground(Job job, JobCounter* counter = NULL);
+    void Wait(JobCounter& counter);
+
+    // calls f(first, last) on chunks of at most grainSize elements of
+    // [begin, end) in parallel and returns once all of them are done
+    template <typename F>
+    void ParallelFor(int begin, int end, int grainSize, F f);
+
+private:
+    class Worker;
+
+    struct Task
+    {
+        Job job;
+        JobCounter* counter;
+    };
+
+    struct Queue
+    {
+        QMutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    int GetQueueIndex_() const;
+    void Push_(Queue& queue, Job job, JobCounter* counter);
+    bool RunOne_(int queueIndex, bool background);
+    void WorkerLoop_(int queueIndex);
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    Queue background_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+
+    QMutex sleepMutex_;
+    QWaitCondition wake_;
+    std::atomic<int> queued_ { 0 };
+    bool stopping_ = false;
+};
+
+template <typename F>
+void JobSystem::ParallelFor(int begin, int end, int grainSize, F f)
+{
+    grainSize = std::max(grainSize, 1);
+    if (end - begin <= grainSize)
+    {
+        if (begin < end)
+        {
+            f(begin, end);
+        }
+        return;
+    }
+
+    // the first chunk stays with the caller
+    JobCounter counter;
+    for (int first = begin + grainSize; first < end; first += grainSize)
+    {
+        int last = std::min(first + grainSize, end);
+        Run([&f, first, last]()
+        {
+            f(first, last);
+        }, &counter);
+    }
+
+    f(begin, begin + grainSize);
+    Wait(counter);
+}
@@ -1,5 +1,6 @@
 #include "LevelMap.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 
@@ -8,6 +9,8 @@
 #include "Actor.hpp"
 #include "utils.hpp"
 
+static const int revisionChunkSize = 8;
+
 LevelMap::LevelMap(int columnCount, int rowCount)
     : columnCount_(columnCount)
     , rowCount_(rowCount)
@@ -56,7 +59,215 @@ int LevelMap::GetCell(float column, float row) const
 
 void LevelMap::SetCell(int column, int row, int value)
 {
-    data_[row * columnCount_ + column] = value;
+    int index = row * columnCount_ + column;
+    bool wasWalkable = data_[index] != '#';
+    bool walkable = value != '#';
+
+    data_[index] = value;
+    revision_++;
+    chunkRevisions_[(row / revisionChunkSize) * chunkColumnCount_ + column / revisionChunkSize]++;
+
+    if (componentsDirty_ || wasWalkable == walkable)
+    {
+        return;
+    }
+
+    // a new wall may split an area, which union-find can not undo
+    if (!walkable)
+    {
+        componentsDirty_ = true;
+        labelsDirty_ = true;
+        return;
+    }
+
+    componentParent_[index] = index;
+    componentSize_[index] = 1;
+
+    for (unsigned i = 1; i < directionToVector.size(); i++)
+    {
+        int neighbourColumn = column + static_cast<int>(directionToVector[i].x);
+        int neighbourRow = row + static_cast<int>(directionToVector[i].y);
+        if (GetCell(neighbourColumn, neighbourRow) != '#')
+        {
+            UniteComponents_(index, neighbourRow * columnCount_ + neighbourColumn);
+        }
+    }
+
+    labelsDirty_ = true;
+}
+
+unsigned LevelMap::GetRevision() const
+{
+    return revision_;
+}
+
+unsigned LevelMap::GetAreaRevision(int minColumn, int minRow, int maxColumn, int maxRow) const
+{
+    if (chunkRevisions_.empty())
+    {
+        return revision_;
+    }
+
+    int chunkRowCount = chunkRevisions_.size() / chunkColumnCount_;
+    int minChunkColumn = std::max(minColumn, 0) / revisionChunkSize;
+    int minChunkRow = std::max(minRow, 0) / revisionChunkSize;
+    int maxChunkColumn = std::min(maxColumn / revisionChunkSize, chunkColumnCount_ - 1);
+    int maxChunkRow = std::min(maxRow / revisionChunkSize, chunkRowCount - 1);
+
+    // chunk revisions only grow, so does their sum
+    unsigned revision = 0;
+    for (int i = minChunkRow; i <= maxChunkRow; i++)
+    {
+        for (int j = minChunkColumn; j <= maxChunkColumn; j++)
+        {
+            revision += chunkRevisions_[i * chunkColumnCount_ + j];
+        }
+    }
+    return revision;
+}
+
+float LevelMap::SweepBox(const Vector2& position
+                         , float size
+                         , const Vector2& delta
+                         , Vector2& normal) const
+{
+    // Traverses column and row boundaries in the order the box's leading
+    // edges cross them, the strip of cells entered at each crossing is
+    // tested against the box's extent at that moment.
+    const float epsilon = 0.0001f;
+    float half = size * 0.5f;
+
+    if (delta.x == 0.0f && delta.y == 0.0f)
+    {
+        return 1.0f;
+    }
+
+    int stepX = delta.x > 0.0f ? 1 : -1;
+    int stepY = delta.y > 0.0f ? 1 : -1;
+
+    float edgeX = position.x + half * stepX;
+    float edgeY = position.y + half * stepY;
+
+    // next column/row to be entered and the time its boundary is reached
+    int column = GridRound(edgeX - epsilon * stepX) + stepX;
+    int row = GridRound(edgeY - epsilon * stepY) + stepY;
+
+    float tMaxX = 2.0f;
+    float tDeltaX = 0.0f;
+    if (delta.x != 0.0f)
+    {
+        float boundary = stepX > 0 ? column : column + 1;
+        tMaxX = (boundary - edgeX) / delta.x;
+        tDeltaX = 1.0f / fabs(delta.x);
+    }
+
+    float tMaxY = 2.0f;
+    float tDeltaY = 0.0f;
+    if (delta.y != 0.0f)
+    {
+        float boundary = stepY > 0 ? row : row + 1;
+        tMaxY = (boundary - edgeY) / delta.y;
+        tDeltaY = 1.0f / fabs(delta.y);
+    }
+
+    while (true)
+    {
+        if (tMaxX <= tMaxY)
+        {
+            float t = std::max(tMaxX, 0.0f);
+            if (t > 1.0f)
+            {
+                break;
+            }
+
+            float y = position.y + delta.y * t;
+            if (HasWall_(column
+                         , GridRound(y - half + epsilon)
+                         , GridRound(y + half - epsilon)))
+            {
+                normal = Vector2(-stepX, 0.0f);
+                return t;
+            }
+
+            column += stepX;
+            tMaxX += tDeltaX;
+        }
+        else
+        {
+            float t = std::max(tMaxY, 0.0f);
+            if (t > 1.0f)
+            {
+                break;
+            }
+
+            float x = position.x + delta.x * t;
+            if (HasWallInRow_(row
+                              , GridRound(x - half + epsilon)
+                              , GridRound(x + half - epsilon)))
+            {
+                normal = Vector2(0.0f, -stepY);
+                return t;
+            }
+
+            row += stepY;
+            tMaxY += tDeltaY;
+        }
+    }
+
+    return 1.0f;
+}
+
+void LevelMap::UpdateComponents()
+{
+    if (componentsDirty_)
+    {
+        RebuildComponents_();
+    }
+
+    if (!labelsDirty_)
+    {
+        return;
+    }
+
+    int cellCount = columnCount_ * rowCount_;
+    componentLabels_.resize(cellCount);
+    mainComponent_ = -1;
+    int mainSize = 0;
+    for (int i = 0; i < cellCount; i++)
+    {
+        componentLabels_[i] = data_[i] == '#' ? -1 : FindComponent_(i);
+        if (componentParent_[i] == i && componentSize_[i] > mainSize)
+        {
+            mainComponent_ = i;
+            mainSize = componentSize_[i];
+        }
+    }
+    labelsDirty_ = false;
+}
+
+int LevelMap::GetComponent(int column, int row) const
+{
+    assert(!labelsDirty_);
+
+    if (GetCell(column, row) == '#')
+    {
+        return -1;
+    }
+
+    return componentLabels_[row * columnCount_ + column];
+}
+
+bool LevelMap::IsReachable(int column0, int row0, int column1, int row1) const
+{
+    int component = GetComponent(column0, row0);
+    return component != -1 && component == GetComponent(column1, row1);
+}
+
+int LevelMap::GetMainComponent() const
+{
+    assert(!labelsDirty_);
+
+    return mainComponent_;
 }
 
 const std::vector<Actor*>& LevelMap::GetActors(int column, int row) const
@@ -78,10 +289,37 @@ void LevelMap::Resize(int columnCount, int rowCount)
 {
     columnCount_ = columnCount;
     rowCount_ = rowCount;
+    revision_++;
+    componentsDirty_ = true;
+    labelsDirty_ = true;
 
     InitData_();
 }
 
+void LevelMap::GetActorCells_(const Actor* actor
+                              , int& minColumn
+                              , int& minRow
+                              , int& maxColumn
+                              , int& maxRow) const
+{
+    GetBoxCells_(actor->GetPosition(), actor->GetSize(), minColumn, minRow, maxColumn, maxRow);
+}
+
+void LevelMap::GetBoxCells_(const Vector2& position
+                            , float size
+                            , int& minColumn
+                            , int& minRow
+                            , int& maxColumn
+                            , int& maxRow) const
+{
+    // same cells an actor's corners are indexed in
+    float half = size * 0.5f;
+    minColumn = GridRound(position.x - half);
+    minRow = GridRound(position.y - half);
+    maxColumn = GridRound(position.x + half);
+    maxRow = GridRound(position.y + half);
+}
+
 void LevelMap::IndexActor(Actor* actor)
 {
     auto cells = actor->GetOccupiedCells();
@@ -117,6 +355,41 @@ void LevelMap::RemoveActor(const Actor* actor)
     }
 }
 
+void LevelMap::MoveActor(Actor* actor, const Vector2& from)
+{
+    int minColumn;
+    int minRow;
+    int maxColumn;
+    int maxRow;
+    GetBoxCells_(from, actor->GetSize(), minColumn, minRow, maxColumn, maxRow);
+
+    int newMinColumn;
+    int newMinRow;
+    int newMaxColumn;
+    int newMaxRow;
+    GetActorCells_(actor, newMinColumn, newMinRow, newMaxColumn, newMaxRow);
+
+    // most steps stay within the same cells
+    if (minColumn == newMinColumn
+        && minRow == newMinRow
+        && maxColumn == newMaxColumn
+        && maxRow == newMaxRow)
+    {
+        return;
+    }
+
+    for (int i = std::max(minRow, 0); i <= std::min(maxRow, rowCount_ - 1); i++)
+    {
+        for (int j = std::max(minColumn, 0); j <= std::min(maxColumn, columnCount_ - 1); j++)
+        {
+            auto& a = actors_[i * columnCount_ + j];
+            a.erase(std::remove(a.begin(), a.end(), actor), a.end());
+        }
+    }
+
+    IndexActor(actor);
+}
+
 void LevelMap::ExportToImage(const QString filename)
 {
     QImage map(GetColumnCount(), GetRowCount(), QImage::Format_ARGB32);
@@ -139,6 +412,92 @@ void LevelMap::ExportToImage(const QString filename)
     map.save(filename);
 }
 
+bool LevelMap::HasWall_(int column, int minRow, int maxRow) const
+{
+    for (int row = minRow; row <= maxRow; row++)
+    {
+        if (GetCell(column, row) == '#')
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LevelMap::HasWallInRow_(int row, int minColumn, int maxColumn) const
+{
+    for (int column = minColumn; column <= maxColumn; column++)
+    {
+        if (GetCell(column, row) == '#')
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void LevelMap::RebuildComponents_()
+{
+    componentParent_.assign(columnCount_ * rowCount_, -1);
+    componentSize_.assign(columnCount_ * rowCount_, 0);
+
+    for (int i = 0; i < rowCount_; i++)
+    {
+        for (int j = 0; j < columnCount_; j++)
+        {
+            int index = i * columnCount_ + j;
+            if (data_[index] == '#')
+            {
+                continue;
+            }
+
+            componentParent_[index] = index;
+            componentSize_[index] = 1;
+
+            // west and north neighbours are labeled already
+            if (j > 0 && data_[index - 1] != '#')
+            {
+                UniteComponents_(index, index - 1);
+            }
+            if (i > 0 && data_[index - columnCount_] != '#')
+            {
+                UniteComponents_(index, index - columnCount_);
+            }
+        }
+    }
+
+    componentsDirty_ = false;
+    labelsDirty_ = true;
+}
+
+int LevelMap::FindComponent_(int index)
+{
+    while (componentParent_[index] != index)
+    {
+        // path halving keeps later lookups close to constant
+        componentParent_[index] = componentParent_[componentParent_[index]];
+        index = componentParent_[index];
+    }
+    return index;
+}
+
+void LevelMap::UniteComponents_(int index0, int index1)
+{
+    int root0 = FindComponent_(index0);
+    int root1 = FindComponent_(index1);
+    if (root0 == root1)
+    {
+        return;
+    }
+
+    if (componentSize_[root0] < componentSize_[root1])
+    {
+        std::swap(root0, root1);
+    }
+    componentParent_[root1] = root0;
+    componentSize_[root0] += componentSize_[root1];
+}
+
 void LevelMap::InitData_()
 {
     if (data_ != NULL)
@@ -148,6 +507,12 @@ void LevelMap::InitData_()
     }
 
     data_ = new int [columnCount_ * rowCount_];
+
+    // start above every revision handed out before the resize
+    chunkColumnCount_ = (columnCount_ + revisionChunkSize - 1) / revisionChunkSize;
+    int chunkRowCount = (rowCount_ + revisionChunkSize - 1) / revisionChunkSize;
+    chunkRevisions_.assign(chunkColumnCount_ * chunkRowCount, revision_);
+
     actors_ = new std::vector<Actor*> [columnCount_ * rowCount_];
 
     for (int i = 0; i < columnCount_ * rowCount_; i++)
@@ -1,11 +1,11 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
 #include <QString>
 
 #include "2de_Box.h"
-
-class Actor;
+#include "Actor.hpp"
 
 class LevelMap
 {
@@ -20,21 +20,125 @@ public:
     int GetCell(float column, float row) const;
     void SetCell(int column, int row, int value);
 
+    // bumped by every change to the cells, lets derived data
+    // notice it has gone stale
+    unsigned GetRevision() const;
+    // same for the cells of an area only, changes whenever
+    // any cell near the area changes
+    unsigned GetAreaRevision(int minColumn, int minRow, int maxColumn, int maxRow) const;
+
+    // Sweeps a square of given size centered at position along delta
+    // through the grid. Returns the fraction of delta travelled before
+    // touching a wall, 1.0f if none is hit; the wall's normal goes to
+    // normal, which is left untouched otherwise.
+    float SweepBox(const Deku2D::Vector2& position
+                   , float size
+                   , const Deku2D::Vector2& delta
+                   , Deku2D::Vector2& normal) const;
+
+    // Connected areas of walkable cells labeled with union-find. Opening
+    // a cell merges labels in place, walling one up relabels the whole
+    // map. Either happens in UpdateComponents, which the owner calls on its
+    // own thread after changing cells. The queries only read the labels,
+    // so path jobs can use them from any thread, and they must not be
+    // called while an update is pending. Walls and cells outside have
+    // label -1.
+    void UpdateComponents();
+    int GetComponent(int column, int row) const;
+    bool IsReachable(int column0, int row0, int column1, int row1) const;
+    // label of the largest area
+    int GetMainComponent() const;
+
     const std::vector<Actor*>& GetActors(int column, int row) const;
 
+    // Range queries, f is called once for every actor of type T found,
+    // however many cells of the range it occupies. Nothing is allocated.
+
+    // actors occupying any cell of the range
+    template <typename T = Actor, typename F>
+    void ForEachActorInCells(int minColumn, int minRow, int maxColumn, int maxRow, F f) const;
+
     void Resize(int columnCount, int rowCount);
 
     void IndexActor(Actor* actor);
     void RemoveActor(const Actor* actor);
+    // refiles an actor that moved since it was indexed at from
+    void MoveActor(Actor* actor, const Deku2D::Vector2& from);
 
     void ExportToImage(const QString filename);
 
 private:
     void InitData_();
+    void GetActorCells_(const Actor* actor
+                        , int& minColumn
+                        , int& minRow
+                        , int& maxColumn
+                        , int& maxRow) const;
+    void GetBoxCells_(const Deku2D::Vector2& position
+                      , float size
+                      , int& minColumn
+                      , int& minRow
+                      , int& maxColumn
+                      , int& maxRow) const;
+    bool HasWall_(int column, int minRow, int maxRow) const;
+    bool HasWallInRow_(int row, int minColumn, int maxColumn) const;
+    void RebuildComponents_();
+    int FindComponent_(int index);
+    void UniteComponents_(int index0, int index1);
 
     int rowCount_;
     int columnCount_;
+    unsigned revision_ = 0;
+    // revisions of square chunks of cells
+    std::vector<unsigned> chunkRevisions_;
+    int chunkColumnCount_ = 0;
     int* data_;
     std::vector<Actor*>* actors_;
     std::vector<Actor*> emptyActors_;
+
+    // union-find forest, only touched by SetCell and UpdateComponents
+    std::vector<int> componentParent_;
+    std::vector<int> componentSize_;
+    bool componentsDirty_ = true;
+    // what the queries read, the root of every cell's area
+    std::vector<int> componentLabels_;
+    bool labelsDirty_ = true;
+    int mainComponent_ = -1;
 };
+
+template <typename T, typename F>
+void LevelMap::ForEachActorInCells(int minColumn, int minRow, int maxColumn, int maxRow, F f) const
+{
+    minColumn = std::max(minColumn, 0);
+    minRow = std::max(minRow, 0);
+    maxColumn = std::min(maxColumn, columnCount_ - 1);
+    maxRow = std::min(maxRow, rowCount_ - 1);
+
+    for (int i = minRow; i <= maxRow; i++)
+    {
+        for (int j = minColumn; j <= maxColumn; j++)
+        {
+            for (Actor* a : actors_[i * columnCount_ + j])
+            {
+                // an actor spanning several cells of the range is only
+                // reported in the first of them
+                int actorMinColumn;
+                int actorMinRow;
+                int actorMaxColumn;
+                int actorMaxRow;
+                GetActorCells_(a, actorMinColumn, actorMinRow, actorMaxColumn, actorMaxRow);
+                if (std::max(actorMinColumn, minColumn) != j
+                    || std::max(actorMinRow, minRow) != i)
+                {
+                    continue;
+                }
+
+                T* actor = dynamic_cast<T*>(a);
+                if (actor)
+                {
+                    f(actor);
+                }
+            }
+        }
+    }
+}
@@ -5,7 +5,7 @@
 #include "Server.hpp"
 #include "GameServer.hpp"
 
-MainWindow::MainWindow(QWidget *parent)
+MainWindow::MainWindow(int workerCount, bool pinWorkers, QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
 {
@@ -19,19 +19,21 @@ MainWindow::MainWindow(QWidget *parent)
 #endif
 
     server_ = new Server;
-    gameServer_ = new GameServer;
+    gameServer_ = new GameServer(workerCount, pinWorkers);
 
+    // runs on the I/O threads, the game server hands
+    // the requests over to its own thread
     connect(server_
             , &Server::newFEMPRequest
             , gameServer_
             , &GameServer::handleFEMPRequest
             , Qt::DirectConnection);
 
+    // reported by the HTTP threads, queued to the simulation's thread
     connect(server_
             , &Server::wsAddressChanged
             , gameServer_
-            , &GameServer::setWSAddress
-            , Qt::DirectConnection);
+            , &GameServer::setWSAddress);
 
     connect(gameServer_
             , &GameServer::broadcastMessage
@@ -47,6 +49,8 @@ MainWindow::MainWindow(QWidget *parent)
 
 MainWindow::~MainWindow()
 {
+    // no more requests from the I/O threads into a dying game server
+    server_->disconnect(gameServer_);
     delete gameServer_;
     delete server_;
     delete ui;
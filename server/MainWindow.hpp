@@ -16,7 +16,8 @@ class MainWindow : public QMainWindow
     Q_OBJECT
 
 public:
-    explicit MainWindow(QWidget *parent = 0);
+    // the simulation's job workers, see GameServer
+    explicit MainWindow(int workerCount = 0, bool pinWorkers = false, QWidget *parent = 0);
     ~MainWindow();
 
 private slots:
@@ -0,0 +1,385 @@
+#include "PathFinder.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+
+#include <QMutexLocker>
+
+#include "LevelMap.hpp"
+
+//==============================================================================
+PathFinder::PathFinder(const LevelMap& levelMap, JobSystem& jobs)
+    : levelMap_(levelMap)
+    , jobs_(jobs)
+{
+
+}
+
+//==============================================================================
+PathFinder::~PathFinder()
+{
+    jobs_.Wait(searches_);
+}
+
+//==============================================================================
+int PathFinder::GetRegionSize() const
+{
+    return regionSize_;
+}
+
+//==============================================================================
+void PathFinder::SetRegionSize(int regionSize)
+{
+    QMutexLocker locker(&cacheMutex_);
+    regionSize_ = regionSize;
+    cache_.clear();
+}
+
+//==============================================================================
+int PathFinder::Request(int startColumn, int startRow, int goalColumn, int goalRow)
+{
+    UpdateGrid_();
+
+    Result result;
+    result.requestId = ++lastRequestId_;
+
+    auto key = MakeKey_(startColumn, startRow, goalColumn, goalRow);
+
+    // separate areas would only be proven apart by exhausting the search
+    if (!levelMap_.IsReachable(startColumn, startRow, goalColumn, goalRow))
+    {
+        result.found = false;
+        PushResult_(result);
+    }
+    else if (FindCached_(key, startColumn, startRow, result.path))
+    {
+        result.found = true;
+        PushResult_(result);
+    }
+    else
+    {
+        auto grid = grid_;
+        int requestId = result.requestId;
+        // never run by the simulation thread while it waits on a tick job
+        jobs_.RunBackground([=]()
+        {
+            FindPath_(grid, key, requestId, startColumn, startRow, goalColumn, goalRow);
+        }, &searches_);
+    }
+
+    return result.requestId;
+}
+
+//==============================================================================
+void PathFinder::TakeResults(std::vector<Result>& results)
+{
+    QMutexLocker locker(&resultsMutex_);
+    results.swap(results_);
+    results_.clear();
+}
+
+//==============================================================================
+void PathFinder::FindPath_(std::shared_ptr<const PathGrid> grid
+                           , CacheKey key
+                           , int requestId
+                           , int startColumn
+                           , int startRow
+                           , int goalColumn
+                           , int goalRow)
+{
+    Result result;
+    result.requestId = requestId;
+    result.found = FindPath(*grid, startColumn, startRow, goalColumn, goalRow, result.path);
+    if (result.found)
+    {
+        Path cached;
+        cached.reserve(result.path.size() + 1);
+        cached.push_back(std::make_pair(startColumn, startRow));
+        cached.insert(cached.end(), result.path.begin(), result.path.end());
+        CachePath_(grid->revision, key, cached);
+    }
+    PushResult_(result);
+}
+
+//==============================================================================
+void PathFinder::UpdateGrid_()
+{
+    if (grid_ && grid_->revision == levelMap_.GetRevision())
+    {
+        return;
+    }
+
+    std::shared_ptr<PathGrid> grid = std::make_shared<PathGrid>();
+    grid->revision = levelMap_.GetRevision();
+    grid->columnCount = levelMap_.GetColumnCount();
+    grid->rowCount = levelMap_.GetRowCount();
+    grid->walkable.resize(grid->columnCount * grid->rowCount);
+
+    for (int i = 0; i < grid->rowCount; i++)
+    {
+        for (int j = 0; j < grid->columnCount; j++)
+        {
+            grid->walkable[i * grid->columnCount + j] = levelMap_.GetCell(j, i) != '#';
+        }
+    }
+
+    grid_ = grid;
+
+    QMutexLocker locker(&cacheMutex_);
+    cacheRevision_ = grid_->revision;
+    cache_.clear();
+}
+
+//==============================================================================
+void PathFinder::PushResult_(Result& result)
+{
+    QMutexLocker locker(&resultsMutex_);
+    results_.push_back(Result());
+    results_.back().requestId = result.requestId;
+    results_.back().found = result.found;
+    results_.back().path.swap(result.path);
+}
+
+//==============================================================================
+void PathFinder::CachePath_(unsigned revision, const CacheKey& key, const Path& path)
+{
+    QMutexLocker locker(&cacheMutex_);
+    // searched on a grid the map has moved on from
+    if (revision != cacheRevision_)
+    {
+        return;
+    }
+    cache_[key] = path;
+}
+
+//==============================================================================
+bool PathFinder::FindCached_(const CacheKey& key, int startColumn, int startRow, Path& path)
+{
+    QMutexLocker locker(&cacheMutex_);
+
+    auto it = cache_.find(key);
+    if (it == cache_.end())
+    {
+        return false;
+    }
+
+    // the cached path started elsewhere in the region,
+    // usable if this start lies on one of its segments
+    const Path& cached = it->second;
+    for (size_t i = 0; i + 1 < cached.size(); i++)
+    {
+        int minColumn = std::min(cached[i].first, cached[i + 1].first);
+        int maxColumn = std::max(cached[i].first, cached[i + 1].first);
+        int minRow = std::min(cached[i].second, cached[i + 1].second);
+        int maxRow = std::max(cached[i].second, cached[i + 1].second);
+
+        if (startColumn >= minColumn
+            && startColumn <= maxColumn
+            && startRow >= minRow
+            && startRow <= maxRow)
+        {
+            path.assign(cached.begin() + i + 1, cached.end());
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//==============================================================================
+PathFinder::CacheKey PathFinder::MakeKey_(int startColumn, int startRow, int goalColumn, int goalRow) const
+{
+    int regionColumnCount = (grid_->columnCount + regionSize_ - 1) / regionSize_;
+    int startRegion = (startRow / regionSize_) * regionColumnCount + startColumn / regionSize_;
+    int goal = goalRow * grid_->columnCount + goalColumn;
+    return std::make_pair(startRegion, goal);
+}
+
+//==============================================================================
+bool PathFinder::FindPath(const PathGrid& grid
+                          , int startColumn
+                          , int startRow
+                          , int goalColumn
+                          , int goalRow
+                          , Path& path)
+{
+    path.clear();
+
+    if (!grid.IsWalkable(startColumn, startRow)
+        || !grid.IsWalkable(goalColumn, goalRow))
+    {
+        return false;
+    }
+
+    if (startColumn == goalColumn && startRow == goalRow)
+    {
+        return true;
+    }
+
+    int columnCount = grid.columnCount;
+    int cellCount = columnCount * grid.rowCount;
+
+    // per thread scratch, stamped instead of cleared between searches
+    static thread_local std::vector<int> cost;
+    static thread_local std::vector<int> parent;
+    static thread_local std::vector<unsigned> stamp;
+    static thread_local unsigned generation = 0;
+
+    if (static_cast<int>(stamp.size()) < cellCount)
+    {
+        cost.resize(cellCount);
+        parent.resize(cellCount);
+        stamp.assign(cellCount, 0);
+        generation = 0;
+    }
+    generation++;
+
+    auto isGoal = [&](int column, int row)
+    {
+        return column == goalColumn && row == goalRow;
+    };
+
+    auto walkable = [&](int column, int row)
+    {
+        return grid.IsWalkable(column, row);
+    };
+
+    // horizontal runs stop where a wall behind opens up above or below
+    auto jumpHorizontal = [&](int column, int row, int dx, int& outColumn) -> bool
+    {
+        while (true)
+        {
+            column += dx;
+            if (!walkable(column, row))
+            {
+                return false;
+            }
+            if (isGoal(column, row)
+                || (walkable(column, row - 1) && !walkable(column - dx, row - 1))
+                || (walkable(column, row + 1) && !walkable(column - dx, row + 1)))
+            {
+                outColumn = column;
+                return true;
+            }
+        }
+    };
+
+    // vertical runs also stop wherever a horizontal run would find something
+    auto jumpVertical = [&](int column, int row, int dy, int& outRow) -> bool
+    {
+        int unused;
+        while (true)
+        {
+            row += dy;
+            if (!walkable(column, row))
+            {
+                return false;
+            }
+            if (isGoal(column, row)
+                || (walkable(column - 1, row) && !walkable(column - 1, row - dy))
+                || (walkable(column + 1, row) && !walkable(column + 1, row - dy))
+                || jumpHorizontal(column, row, 1, unused)
+                || jumpHorizontal(column, row, -1, unused))
+            {
+                outRow = row;
+                return true;
+            }
+        }
+    };
+
+    auto heuristic = [&](int column, int row)
+    {
+        return std::abs(column - goalColumn) + std::abs(row - goalRow);
+    };
+
+    typedef std::pair<int, int> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+
+    int start = startRow * columnCount + startColumn;
+    stamp[start] = generation;
+    cost[start] = 0;
+    parent[start] = -1;
+    open.push(std::make_pair(heuristic(startColumn, startRow), start));
+
+    while (!open.empty())
+    {
+        int current = open.top().second;
+        int f = open.top().first;
+        open.pop();
+
+        int column = current % columnCount;
+        int row = current / columnCount;
+
+        if (f - heuristic(column, row) > cost[current])
+        {
+            continue;
+        }
+
+        if (isGoal(column, row))
+        {
+            for (int node = current; node != start; node = parent[node])
+            {
+                path.push_back(std::make_pair(node % columnCount, node / columnCount));
+            }
+            std::reverse(path.begin(), path.end());
+            return true;
+        }
+
+        // pruned neighbours: straight on and the sides,
+        // every direction from the start
+        int dx = 0;
+        int dy = 0;
+        if (parent[current] != -1)
+        {
+            int parentColumn = parent[current] % columnCount;
+            int parentRow = parent[current] / columnCount;
+            dx = (column > parentColumn) - (column < parentColumn);
+            dy = (row > parentRow) - (row < parentRow);
+        }
+
+        static const int directions[4][2] =
+        {
+            {1, 0},
+            {-1, 0},
+            {0, 1},
+            {0, -1},
+        };
+
+        for (auto& direction : directions)
+        {
+            int ndx = direction[0];
+            int ndy = direction[1];
+
+            // never straight back
+            if ((dx != 0 || dy != 0) && ndx == -dx && ndy == -dy)
+            {
+                continue;
+            }
+
+            int jumpColumn = column;
+            int jumpRow = row;
+            bool found = ndx != 0
+                         ? jumpHorizontal(column, row, ndx, jumpColumn)
+                         : jumpVertical(column, row, ndy, jumpRow);
+            if (!found)
+            {
+                continue;
+            }
+
+            int next = jumpRow * columnCount + jumpColumn;
+            int nextCost = cost[current] + std::abs(jumpColumn - column) + std::abs(jumpRow - row);
+
+            if (stamp[next] != generation || nextCost < cost[next])
+            {
+                stamp[next] = generation;
+                cost[next] = nextCost;
+                parent[next] = current;
+                open.push(std::make_pair(nextCost + heuristic(jumpColumn, jumpRow), next));
+            }
+        }
+    }
+
+    return false;
+}
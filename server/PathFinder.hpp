@@ -0,0 +1,111 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+
+#include <QMutex>
+
+#include "JobSystem.hpp"
+
+class LevelMap;
+
+// cells to walk through, straight lines in between
+typedef std::vector<std::pair<int, int>> Path;
+
+// Walkability of the level map frozen at some revision, searches running
+// on the pool keep using theirs while the map moves on.
+struct PathGrid
+{
+    unsigned revision = 0;
+    int columnCount = 0;
+    int rowCount = 0;
+    std::vector<char> walkable;
+
+    bool IsWalkable(int column, int row) const
+    {
+        return column >= 0
+               && row >= 0
+               && column < columnCount
+               && row < rowCount
+               && walkable[row * columnCount + column] != 0;
+    }
+};
+
+// Jump point search over the level map's four-connected grid. Requests
+// are solved asynchronously on the job system and picked up by the
+// simulation whenever it is ready, so a long search never holds a tick.
+// Paths are cached by start region and goal until the map changes.
+class PathFinder
+{
+public:
+    struct Result
+    {
+        int requestId;
+        bool found;
+        // turning points after the start cell, the goal cell last
+        Path path;
+    };
+
+    PathFinder(const LevelMap& levelMap, JobSystem& jobs);
+    virtual ~PathFinder();
+
+    int GetRegionSize() const;
+    void SetRegionSize(int regionSize);
+
+    // returns id the result will be reported with
+    int Request(int startColumn, int startRow, int goalColumn, int goalRow);
+
+    // hands over results finished since the last call
+    void TakeResults(std::vector<Result>& results);
+
+    // synchronous search, safe to call from any thread
+    static bool FindPath(const PathGrid& grid
+                         , int startColumn
+                         , int startRow
+                         , int goalColumn
+                         , int goalRow
+                         , Path& path);
+
+private:
+    typedef std::pair<int, int> CacheKey;
+
+    struct CacheKeyHash
+    {
+        size_t operator()(const CacheKey& key) const
+        {
+            return std::hash<long long>()((static_cast<long long>(key.first) << 32) ^ key.second);
+        }
+    };
+
+    void FindPath_(std::shared_ptr<const PathGrid> grid
+                   , CacheKey key
+                   , int requestId
+                   , int startColumn
+                   , int startRow
+                   , int goalColumn
+                   , int goalRow);
+    void UpdateGrid_();
+    void PushResult_(Result& result);
+    void CachePath_(unsigned revision, const CacheKey& key, const Path& path);
+    bool FindCached_(const CacheKey& key, int startColumn, int startRow, Path& path);
+    CacheKey MakeKey_(int startColumn, int startRow, int goalColumn, int goalRow) const;
+
+    const LevelMap& levelMap_;
+    std::shared_ptr<const PathGrid> grid_;
+    int regionSize_ = 8;
+    int lastRequestId_ = 0;
+
+    JobSystem& jobs_;
+    // searches still running, waited for on destruction
+    JobCounter searches_;
+
+    QMutex resultsMutex_;
+    std::vector<Result> results_;
+
+    QMutex cacheMutex_;
+    unsigned cacheRevision_ = 0;
+    // start cell of the cached path is its first element
+    std::unordered_map<CacheKey, Path, CacheKeyHash> cache_;
+};
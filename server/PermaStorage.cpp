@@ -7,14 +7,26 @@
 #include <QDebug>
 #include <QSqlRecord>
 
-PermaStorage::PermaStorage()
+PermaStorage::PermaStorage(const QString& connectionName)
+    : connectionName_(connectionName)
 {
 
 }
 
+PermaStorage::~PermaStorage()
+{
+    if (db_.isValid())
+    {
+        db_.close();
+        // the handle has to go before the connection is removed
+        db_ = QSqlDatabase();
+        QSqlDatabase::removeDatabase(connectionName_);
+    }
+}
+
 bool PermaStorage::Connect()
 {
-    db_ = QSqlDatabase::addDatabase("QPSQL");
+    db_ = QSqlDatabase::addDatabase("QPSQL", connectionName_);
     if (!db_.isValid())
     {
         qDebug() << db_.lastError();
@@ -69,21 +81,21 @@ void PermaStorage::InitSchema()
     )=");
 }
 
-void PermaStorage::AddUser(const QString login, const QString passHash, const QString salt)
+bool PermaStorage::AddUser(const QString login, const QString passHash, const QString salt)
 {
-    QSqlQuery q;
+    QSqlQuery q(db_);
     q.prepare(R"=(INSERT INTO users (login, pass, salt)
         VALUES (:login, :passhash, :salt)
     )=");
     q.bindValue(":login", login);
     q.bindValue(":passhash", passHash);
     q.bindValue(":salt", salt);
-    ExecQuery_(q);
+    return ExecQuery_(q);
 }
 
 QString PermaStorage::GetSalt(const QString login)
 {
-    QSqlQuery q;
+    QSqlQuery q(db_);
     q.prepare("SELECT salt FROM users WHERE login = :login");
     q.bindValue(":login", login);
     if (ExecQuery_(q))
@@ -99,7 +111,7 @@ QString PermaStorage::GetSalt(const QString login)
 
 QString PermaStorage::GetPassHash(const QString login)
 {
-    QSqlQuery q;
+    QSqlQuery q(db_);
     q.prepare("SELECT pass FROM users WHERE login = :login");
     q.bindValue(":login", login);
     if (ExecQuery_(q))
@@ -115,7 +127,7 @@ QString PermaStorage::GetPassHash(const QString login)
 
 bool PermaStorage::IfLoginPresent(const QString login)
 {
-    QSqlQuery q;
+    QSqlQuery q(db_);
     q.prepare("SELECT login FROM users WHERE login = :login");
     q.bindValue(":login", login);
     ExecQuery_(q);
@@ -138,7 +150,7 @@ bool PermaStorage::ExecQuery_(QSqlQuery& query)
 
 bool PermaStorage::ExecQuery_(QString query)
 {
-    QSqlQuery q;
+    QSqlQuery q(db_);
     bool ret = q.exec(query);
     if (!ret)
     {
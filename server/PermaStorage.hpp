@@ -2,22 +2,28 @@
 
 #include <QSqlDatabase>
 
+// A connection to the database, usable from the thread it was opened in
+// only. Threads talking to the database each need their own, under a
+// name of their own.
 class PermaStorage
 {
 public:
-    PermaStorage();
+    PermaStorage(const QString& connectionName = QLatin1String(QSqlDatabase::defaultConnection));
+    virtual ~PermaStorage();
 
     bool Connect();
     void Disconnect();
     void Reset();
     void DropAll();
     void InitSchema();
-    void AddUser(const QString login, const QString passHash, const QString salt);
+    // false if the insert failed, e.g. the login was taken meanwhile
+    bool AddUser(const QString login, const QString passHash, const QString salt);
     QString GetSalt(const QString login);
     QString GetPassHash(const QString login);
     bool IfLoginPresent(const QString login);
 
 private:
+    QString connectionName_;
     QSqlDatabase db_;
 
     bool ExecQuery_(QSqlQuery& query);
@@ -29,3 +29,23 @@ void Player::SetClientTick(const unsigned clientTick)
 {
     clientTick_ = clientTick;
 }
+
+Path& Player::GetPath()
+{
+    return path_;
+}
+
+void Player::SetPath(const Path& path)
+{
+    path_ = path;
+}
+
+int Player::GetPathRequestId() const
+{
+    return pathRequestId_;
+}
+
+void Player::SetPathRequestId(const int pathRequestId)
+{
+    pathRequestId_ = pathRequestId;
+}
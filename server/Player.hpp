@@ -3,6 +3,7 @@
 #include <QString>
 
 #include "Creature.hpp"
+#include "PathFinder.hpp"
 
 class Player : public Creature
 {
@@ -15,7 +16,15 @@ public:
     unsigned GetClientTick() const;
     void SetClientTick(const unsigned clientTick);
 
+    // waypoints left to walk after a click-to-move
+    Path& GetPath();
+    void SetPath(const Path& path);
+    int GetPathRequestId() const;
+    void SetPathRequestId(const int pathRequestId);
+
 private:
     QString login_;
     unsigned clientTick_ = 0;
+    Path path_;
+    int pathRequestId_ = 0;
 };
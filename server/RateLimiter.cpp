@@ -0,0 +1,72 @@
+#include "RateLimiter.hpp"
+
+#include <algorithm>
+
+#include <QMutexLocker>
+
+//==============================================================================
+RateLimiter::RateLimiter()
+{
+    clock_.start();
+}
+
+//==============================================================================
+RateLimiter::~RateLimiter()
+{
+
+}
+
+//==============================================================================
+bool RateLimiter::Take(const QByteArray& key, const Limit& limit)
+{
+    if (limit.rate <= 0.0f)
+    {
+        return true;
+    }
+
+    Shard& shard = shards_[qHash(key) % shardCount_];
+    QMutexLocker locker(&shard.mutex);
+
+    qint64 now = clock_.elapsed();
+    if (now - shard.lastPrune > pruneInterval_)
+    {
+        Prune_(shard, now);
+    }
+
+    auto it = shard.buckets.find(key);
+    if (it == shard.buckets.end())
+    {
+        Bucket bucket;
+        bucket.tokens = limit.burst - 1.0f;
+        bucket.lastUpdate = now;
+        bucket.burst = limit.burst;
+        bucket.rate = limit.rate;
+        shard.buckets.insert(key, bucket);
+        return true;
+    }
+
+    Bucket& bucket = it.value();
+    bucket.tokens = std::min(limit.burst, bucket.tokens + (now - bucket.lastUpdate) * 0.001f * limit.rate);
+    bucket.lastUpdate = now;
+    bucket.burst = limit.burst;
+    bucket.rate = limit.rate;
+
+    if (bucket.tokens < 1.0f)
+    {
+        return false;
+    }
+    bucket.tokens -= 1.0f;
+    return true;
+}
+
+//==============================================================================
+void RateLimiter::Prune_(Shard& shard, qint64 now)
+{
+    shard.lastPrune = now;
+    for (auto it = shard.buckets.begin(); it != shard.buckets.end();)
+    {
+        const Bucket& bucket = it.value();
+        bool full = bucket.tokens + (now - bucket.lastUpdate) * 0.001f * bucket.rate >= bucket.burst;
+        it = full ? shard.buckets.erase(it) : it + 1;
+    }
+}
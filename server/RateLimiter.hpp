@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QElapsedTimer>
+
+// Token buckets by key, safe to use from any thread. A bucket refills at
+// the rate of its limit up to its burst and every request takes a token.
+// Buckets that have filled up again are forgotten from time to time, a
+// forgotten bucket is indistinguishable from a full one.
+class RateLimiter
+{
+public:
+    struct Limit
+    {
+        // tokens per second, 0 for no limit
+        float rate;
+        float burst;
+    };
+
+    RateLimiter();
+    virtual ~RateLimiter();
+
+    // false if the bucket of key has no token left for the request
+    bool Take(const QByteArray& key, const Limit& limit);
+
+private:
+    struct Bucket
+    {
+        float tokens;
+        qint64 lastUpdate;
+        float burst;
+        float rate;
+    };
+
+    // buckets live in shards of their own, threads rarely wait on each other
+    struct Shard
+    {
+        QMutex mutex;
+        QHash<QByteArray, Bucket> buckets;
+        qint64 lastPrune = 0;
+    };
+
+    // drops the buckets that are full again, the shard is locked
+    void Prune_(Shard& shard, qint64 now);
+
+    static const int shardCount_ = 16;
+    Shard shards_[shardCount_];
+
+    QElapsedTimer clock_;
+    // ms between looking for full buckets in a shard
+    qint64 pruneInterval_ = 10000;
+};
@@ -0,0 +1,87 @@
+#include "RegionMap.hpp"
+
+#include <algorithm>
+
+#include "utils.hpp"
+
+RegionMap::RegionMap(int regionSize)
+    : regionSize_(regionSize)
+{
+
+}
+
+RegionMap::~RegionMap()
+{
+
+}
+
+int RegionMap::GetRegionSize() const
+{
+    return regionSize_;
+}
+
+int RegionMap::GetRegionRowCount() const
+{
+    return rowCount_;
+}
+
+int RegionMap::GetRegionColumnCount() const
+{
+    return columnCount_;
+}
+
+void RegionMap::Resize(int columnCount, int rowCount)
+{
+    columnCount_ = (columnCount + regionSize_ - 1) / regionSize_;
+    rowCount_ = (rowCount + regionSize_ - 1) / regionSize_;
+    detail_.assign(columnCount_ * rowCount_, ERegionDetail::DORMANT);
+}
+
+void RegionMap::Clear()
+{
+    std::fill(detail_.begin(), detail_.end(), ERegionDetail::DORMANT);
+}
+
+void RegionMap::Wake(float x, float y, float radius, ERegionDetail detail)
+{
+    int minColumn = std::max(ToRegion_(x - radius), 0);
+    int maxColumn = std::min(ToRegion_(x + radius), columnCount_ - 1);
+    int minRow = std::max(ToRegion_(y - radius), 0);
+    int maxRow = std::min(ToRegion_(y + radius), rowCount_ - 1);
+
+    for (int i = minRow; i <= maxRow; i++)
+    {
+        for (int j = minColumn; j <= maxColumn; j++)
+        {
+            auto& d = detail_[i * columnCount_ + j];
+            d = std::min(d, detail);
+        }
+    }
+}
+
+ERegionDetail RegionMap::GetDetail(float x, float y) const
+{
+    return GetDetail(ToRegion_(x), ToRegion_(y));
+}
+
+ERegionDetail RegionMap::GetDetail(int regionColumn, int regionRow) const
+{
+    if (regionColumn < 0
+        || regionRow < 0
+        || regionColumn >= columnCount_
+        || regionRow >= rowCount_)
+    {
+        return ERegionDetail::DORMANT;
+    }
+    return detail_[regionRow * columnCount_ + regionColumn];
+}
+
+int RegionMap::ToRegion_(float value) const
+{
+    int cell = GridRound(value);
+    if (cell < 0)
+    {
+        return (cell - regionSize_ + 1) / regionSize_;
+    }
+    return cell / regionSize_;
+}
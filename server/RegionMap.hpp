@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+
+// Ordered from the most to the least detailed, a region takes the
+// most detailed level any player grants it
+enum class ERegionDetail
+{
+    FULL,
+    REDUCED,
+    LOW,
+    DORMANT,
+};
+
+// Coarse grid laid over the level map, tracks how close every region is
+// to the players and therefore how often its actors should be simulated.
+// Regions nobody is near stay dormant: their actors keep their state and
+// resume from it once a player comes back within the wake radius.
+class RegionMap
+{
+public:
+    RegionMap(int regionSize);
+    virtual ~RegionMap();
+
+    int GetRegionSize() const;
+    int GetRegionRowCount() const;
+    int GetRegionColumnCount() const;
+
+    // sizes are given in level map cells
+    void Resize(int columnCount, int rowCount);
+
+    // marks every region as dormant, called once per tick before waking
+    void Clear();
+
+    // raises all regions intersecting the square of given radius around
+    // point to at least the given level of detail
+    void Wake(float x, float y, float radius, ERegionDetail detail = ERegionDetail::FULL);
+
+    ERegionDetail GetDetail(float x, float y) const;
+    ERegionDetail GetDetail(int regionColumn, int regionRow) const;
+
+private:
+    int ToRegion_(float value) const;
+
+    int regionSize_;
+    int rowCount_ = 0;
+    int columnCount_ = 0;
+    std::vector<ERegionDetail> detail_;
+};
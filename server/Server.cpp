@@ -5,149 +5,65 @@
 #include <iostream>
 #include <vector>
 
-#include <QFile>
-#include <QFileInfo>
-
-#include "qhttpserver.h"
-#include "qhttprequest.h"
-#include "qhttpresponse.h"
-
 #include "WebSocketThread.hpp"
+#include "HttpThread.hpp"
+#include "AssetCache.hpp"
+#include "RateLimiter.hpp"
 
 Server::Server()
 {
-    httpServer_ = new QHttpServer(this);
+    // served from memory, the files are read once
+    assets_ = new AssetCache("../client", this);
+
+    // requests are accepted and parsed off the main thread,
+    // which is left to the simulation
+    limiter_ = new RateLimiter();
+    httpPool_ = new HttpThreadPool(assets_, limiter_, 0, this);
+
+    connect(httpPool_
+            , &HttpThreadPool::newFEMPRequest
+            , this
+            , &Server::newFEMPRequest
+            , Qt::DirectConnection);
 
-    connect(httpServer_
-            , &QHttpServer::newRequest
+    connect(httpPool_
+            , &HttpThreadPool::wsAddressChanged
             , this
-            , &Server::handleRequest);
+            , &Server::wsAddressChanged
+            , Qt::DirectConnection);
 
     wsServer_ = new QtWebsocket::QWsServer(this);
 
+    // responses are repetitive JSON, the map rows of look above all
+    QtWebsocket::QWsDeflateOptions deflateOptions;
+    deflateOptions.enabled = true;
+    wsServer_->setDeflateOptions(deflateOptions);
+
     QObject::connect(wsServer_
                      , SIGNAL(newConnection())
                      , this
                      , SLOT(processNewWSConnection()));
-}
-
-Server::~Server()
-{
-    delete httpServer_;
-}
-
-void Server::handleRequest(QHttpRequest *request, QHttpResponse *response)
-{
-    auto method = request->method();
 
-    QString host = "";
-    QRegExp ipFromHost("(.*):.*");
-    host = request->header("host");
-    ipFromHost.indexIn(host);
-    host = ipFromHost.cap(1);
+    // one I/O thread per core serves all the websocket connections
+    socketPool_ = new SocketThreadPool(limiter_, 0, this);
 
-    emit wsAddressChanged("ws://" + host + ":" + QString::number(Server::WS_PORT));
+    connect(this
+            , &Server::broadcastMessage
+            , socketPool_
+            , &SocketThreadPool::broadcastMessage);
 
-    switch (method)
-    {
-        case QHttpRequest::HTTP_GET:
-        {
-            auto path = request->path();
-            if (path == "/")
-            {
-                path = "/index.html";
-            }
-            qDebug() << path;
-
-            response->setHeader("Access-Control-Allow-Origin", "*");
-            response->setHeader("Cache-control", "no-cache, no-store");
-
-            auto extension = QFileInfo(path).suffix();
-
-            if (extension == "htm"
-                || extension == "html")
-            {
-                response->setHeader("Content-Type", "text/html; charset=utf-8");
-            }
-            else if (extension == "css")
-            {
-                response->setHeader("Content-Type", "text/css; charset=utf-8");
-            }
-            else if (extension == "js")
-            {
-                response->setHeader("Content-Type", "application/javascript; charset=utf-8");
-            }
-            else
-            {
-                response->setHeader("Content-Type", "text/plain; charset=utf-8");
-            }
-
-            QFile index("../client" + path);
-            QByteArray body;
-
-            if (!index.open(QIODevice::ReadOnly))
-            {
-                body = "404 not found";
-                response->setHeader("Content-Length", QString::number(body.size()));
-                response->setHeader("Content-Type", "text/plain; charset=utf-8");
-                response->writeHead(QHttpResponse::STATUS_NOT_FOUND);
-                response->end(body);
-            }
-            else
-            {
-                body = index.readAll();
-                response->setHeader("Content-Length", QString::number(body.size()));
-                response->writeHead(QHttpResponse::STATUS_OK);
-                response->end(body);
-            }
-        }
-            break;
-
-        case QHttpRequest::HTTP_POST:
-        {
-            response_ = response;
-            connect(request
-                    , &QHttpRequest::end
-                    , this
-                    , &Server::dataEnd);
-
-            connect(request
-                    , &QHttpRequest::data
-                    , this
-                    , &Server::data);
-        }
-            break;
-
-        default:
-        {
-            QByteArray body;
-            body = "404 not found";
-            response->setHeader("Content-Length", QString::number(body.size()));
-            response->setHeader("Content-Type", "text/plain; charset=utf-8");
-            response->writeHead(QHttpResponse::STATUS_NOT_FOUND);
-            response->end(body);
-            qDebug() << "Unsupported HTTP method: " << method;
-        }
-    }
+    connect(socketPool_
+            , &SocketThreadPool::newFEMPRequest
+            , this
+            , &Server::newFEMPRequest
+            , Qt::DirectConnection);
 }
 
-void Server::dataEnd()
+Server::~Server()
 {
-//    qDebug() << "request JSON: " << data_;
-    QVariantMap request = QJsonDocument::fromJson(data_).toVariant().toMap();
-    QVariantMap response;
-
-    emit newFEMPRequest(request, response);
-
-    response_->setHeader("Access-Control-Allow-Origin", "*");
-    response_->setHeader("Content-Type", "application/json; charset=utf-8");
-    response_->writeHead(QHttpResponse::STATUS_OK);
-    auto responseJSON = QJsonDocument::fromVariant(response).toJson();
-//    qDebug() << "response JSON: " << responseJSON;
-    response_->end(responseJSON);
-
-    response_ = NULL;
-    data_.clear();
+    delete socketPool_;
+    delete httpPool_;
+    delete limiter_;
 }
 
 void Server::processNewWSConnection()
@@ -157,34 +73,16 @@ void Server::processNewWSConnection()
     // Get the connecting socket
     QtWebsocket::QWsSocket* socket = wsServer_->nextPendingConnection();
 
-    // Create a new thread and giving to him the socket
-    SocketThread* thread = new SocketThread(socket);
-
-    // connect for message broadcast
-//    QObject::connect(socket, SIGNAL(frameReceived(QString)), this, SIGNAL(broadcastMessage(QString)));
-    QObject::connect(this, SIGNAL(broadcastMessage(QString)), thread, SLOT(sendMessage(QString)));
-
-    connect(thread
-            , SIGNAL(newFEMPRequest(const QVariantMap&, QVariantMap&))
-            , this
-            , SIGNAL(newFEMPRequest(const QVariantMap&, QVariantMap&))
-            , Qt::DirectConnection);
-
-    // Starting the thread
-    thread->start();
+    // Hand the socket over to one of the I/O threads
+    socketPool_->AddSocket(socket);
 }
 
 
-void Server::data(const QByteArray& data)
-{
-    data_.append(data);
-}
-
 void Server::Start()
 {
     if (!running_)
     {
-        running_ = httpServer_->listen(HTTP_PORT);
+        running_ = httpPool_->Listen(HTTP_PORT);
 
         if (!running_)
         {
@@ -193,14 +91,14 @@ void Server::Start()
         }
         else
         {
-            qDebug() << "Server started.";
+            qDebug() << "Server started, HTTP threads:" << httpPool_->GetThreadCount();
         }
 
         if (!wsServer_->listen(QHostAddress::Any, WS_PORT))
         {
             std::cout << QObject::tr("Error: Can't launch server").toStdString() << std::endl;
             std::cout << QObject::tr("QWsServer error : %1").arg(wsServer_->errorString()).toStdString() << std::endl;
-            httpServer_->close();
+            httpPool_->Close();
             running_ = false;
         }
         else
@@ -219,7 +117,7 @@ void Server::Stop()
 {
     if (running_)
     {
-        httpServer_->close();
+        httpPool_->Close();
         wsServer_->close();
         running_ = false;
         qDebug() << "Server stopped.";
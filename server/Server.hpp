@@ -8,16 +8,22 @@
 #include <QString>
 #include <QtCore>
 
-#include "qhttpserverfwd.h"
 #include "QWsServer.h"
 
+#include "FEMP.hpp"
+
+class SocketThreadPool;
+class HttpThreadPool;
+class AssetCache;
+class RateLimiter;
+
 class Server : public QObject
 {
     Q_OBJECT
 
 signals:
-    void broadcastMessage(QString message);
-    void newFEMPRequest(const QVariantMap& request, QVariantMap& response);
+    void broadcastMessage(QByteArray message);
+    void newFEMPRequest(const QVariantMap& request, const QString& peer, FEMPCallback done);
     void wsAddressChanged(QString address);
 
 public slots:
@@ -33,15 +39,11 @@ public:
     void Start();
     void Stop();
 
-private slots:
-    void handleRequest(QHttpRequest *request, QHttpResponse *response);
-    void dataEnd();
-    void data(const QByteArray& data);
-
 private:
-    QHttpServer* httpServer_;
+    HttpThreadPool* httpPool_;
     QtWebsocket::QWsServer* wsServer_;
-    QHttpResponse* response_ = NULL;
-    QByteArray data_;
+    SocketThreadPool* socketPool_;
+    AssetCache* assets_;
+    RateLimiter* limiter_;
     bool running_ = false;    
 };
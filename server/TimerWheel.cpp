@@ -0,0 +1,165 @@
+#include "TimerWheel.hpp"
+
+#include <algorithm>
+
+TimerWheel::TimerWheel()
+    : slots_(levelCount_ * slotsPerLevel_, -1)
+{
+
+}
+
+TimerWheel::~TimerWheel()
+{
+
+}
+
+unsigned TimerWheel::GetTick() const
+{
+    return tick_;
+}
+
+TimerWheel::Handle TimerWheel::Schedule(unsigned delay, Callback callback)
+{
+    const unsigned maxDelay = (1u << (bitsPerLevel_ * levelCount_)) - 1;
+    delay = std::max(std::min(delay, maxDelay), 1u);
+
+    int index = firstFree_;
+    if (index != -1)
+    {
+        firstFree_ = timers_[index].next;
+    }
+    else
+    {
+        index = timers_.size();
+        timers_.push_back(Timer());
+    }
+
+    Timer& timer = timers_[index];
+    timer.callback = std::move(callback);
+    timer.expires = tick_ + delay;
+    Insert_(index);
+
+    Handle handle;
+    handle.index = index;
+    handle.generation = timer.generation;
+    return handle;
+}
+
+bool TimerWheel::Cancel(const Handle& handle)
+{
+    if (!IsPending(handle))
+    {
+        return false;
+    }
+
+    Unlink_(handle.index);
+    Free_(handle.index);
+    return true;
+}
+
+bool TimerWheel::IsPending(const Handle& handle) const
+{
+    return handle.index >= 0
+           && handle.index < static_cast<int>(timers_.size())
+           && timers_[handle.index].generation == handle.generation
+           && timers_[handle.index].slot != -1;
+}
+
+void TimerWheel::Advance(unsigned tick)
+{
+    while (static_cast<int>(tick - tick_) > 0)
+    {
+        tick_++;
+
+        // the finest wheel went round, pull the next slot of the coarser
+        // one down, and further up while those went round too
+        int slot = tick_ & (slotsPerLevel_ - 1);
+        if (slot == 0)
+        {
+            for (int level = 1; level < levelCount_; level++)
+            {
+                int levelSlot = (tick_ >> (level * bitsPerLevel_)) & (slotsPerLevel_ - 1);
+                Cascade_(level, levelSlot);
+                if (levelSlot != 0)
+                {
+                    break;
+                }
+            }
+        }
+
+        // callbacks may schedule and cancel, take timers one at a time
+        while (slots_[slot] != -1)
+        {
+            int index = slots_[slot];
+            Unlink_(index);
+            Callback callback = std::move(timers_[index].callback);
+            Free_(index);
+            callback();
+        }
+    }
+}
+
+void TimerWheel::Insert_(int index)
+{
+    Timer& timer = timers_[index];
+    unsigned delta = timer.expires - tick_;
+
+    int level = 0;
+    while (level + 1 < levelCount_
+           && delta >= (1u << ((level + 1) * bitsPerLevel_)))
+    {
+        level++;
+    }
+
+    int slot = level * slotsPerLevel_
+               + ((timer.expires >> (level * bitsPerLevel_)) & (slotsPerLevel_ - 1));
+
+    timer.slot = slot;
+    timer.previous = -1;
+    timer.next = slots_[slot];
+    if (timer.next != -1)
+    {
+        timers_[timer.next].previous = index;
+    }
+    slots_[slot] = index;
+}
+
+void TimerWheel::Unlink_(int index)
+{
+    Timer& timer = timers_[index];
+    if (timer.previous != -1)
+    {
+        timers_[timer.previous].next = timer.next;
+    }
+    else
+    {
+        slots_[timer.slot] = timer.next;
+    }
+    if (timer.next != -1)
+    {
+        timers_[timer.next].previous = timer.previous;
+    }
+    timer.slot = -1;
+}
+
+void TimerWheel::Free_(int index)
+{
+    Timer& timer = timers_[index];
+    timer.callback = nullptr;
+    timer.generation++;
+    timer.next = firstFree_;
+    firstFree_ = index;
+}
+
+void TimerWheel::Cascade_(int level, int slot)
+{
+    int index = slots_[level * slotsPerLevel_ + slot];
+    slots_[level * slotsPerLevel_ + slot] = -1;
+
+    while (index != -1)
+    {
+        int next = timers_[index].next;
+        Insert_(index);
+        index = next;
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+
+// Hierarchical timing wheel counting in ticks. Scheduling and cancelling
+// are constant time: a timer sits in the slot of the wheel matching how
+// far away it is and drops to finer wheels as its time approaches.
+// Timers fire from Advance, in no particular order within a tick.
+class TimerWheel
+{
+public:
+    typedef std::function<void()> Callback;
+
+    // stays valid after the timer fires or is cancelled,
+    // then refers to nothing
+    struct Handle
+    {
+        int index = -1;
+        unsigned generation = 0;
+    };
+
+    TimerWheel();
+    virtual ~TimerWheel();
+
+    unsigned GetTick() const;
+
+    // fires once delay ticks from now, at least one tick;
+    // delays beyond the outermost wheel are clamped to it
+    Handle Schedule(unsigned delay, Callback callback);
+    // returns false if the timer already fired or was cancelled
+    bool Cancel(const Handle& handle);
+    bool IsPending(const Handle& handle) const;
+
+    // fires every timer due up to and including tick
+    void Advance(unsigned tick);
+
+private:
+    struct Timer
+    {
+        Callback callback;
+        unsigned expires = 0;
+        unsigned generation = 0;
+        // slot the timer is linked into, -1 when free
+        int slot = -1;
+        int previous = -1;
+        int next = -1;
+    };
+
+    void Insert_(int index);
+    void Unlink_(int index);
+    void Free_(int index);
+    void Cascade_(int level, int slot);
+
+    static const int bitsPerLevel_ = 6;
+    static const int slotsPerLevel_ = 1 << bitsPerLevel_;
+    static const int levelCount_ = 4;
+
+    unsigned tick_ = 0;
+    std::vector<Timer> timers_;
+    int firstFree_ = -1;
+    // heads of the timer lists, level after level
+    std::vector<int> slots_;
+};
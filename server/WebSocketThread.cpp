@@ -1,80 +1,329 @@
 #include "WebSocketThread.hpp"
 
+#include <algorithm>
 #include <iostream>
 
-SocketThread::SocketThread(QtWebsocket::QWsSocket* wsSocket) :
-    socket(wsSocket)
+SocketWorker::SocketWorker(RateLimiter* limiter)
+    : limiter_(limiter)
 {
-    // Set this thread as parent of the socket
-    // This will push the socket in the good thread when using moveToThread on the parent
-    if (socket)
-    {
-        socket->setParent(this);
-    }
+    // a child, so it moves to the worker's thread along with it
+    flushTimer_ = new QTimer(this);
+    flushTimer_->setSingleShot(true);
+    flushTimer_->setInterval(flushDelay_);
 
-    // Move this thread object in the thread himsleft
-    // Thats necessary to exec the event loop in this thread
-    moveToThread(this);
+    connect(flushTimer_
+            , &QTimer::timeout
+            , this
+            , &SocketWorker::flushSockets);
+
+    // back to the worker's thread
+    connect(this
+            , &SocketWorker::responseReady
+            , this
+            , &SocketWorker::sendResponse
+            , Qt::QueuedConnection);
 }
 
-SocketThread::~SocketThread()
+SocketWorker::~SocketWorker()
 {
+    for (auto socket : sockets_)
+    {
+        delete socket;
+    }
 }
 
-void SocketThread::run()
+int SocketWorker::GetConnectionCount() const
 {
-    std::cout << tr("connect done in thread : 0x%1")
-        .arg(QString::number((unsigned int)QThread::currentThreadId(), 16))
-        .toStdString() << std::endl;
+    return connectionCount_.load();
+}
 
-    // Connecting the socket signals here to exec the slots in the new thread
-    QObject::connect(socket, SIGNAL(frameReceived(QString)), this, SLOT(processMessage(QString)));
+void SocketWorker::addSocket(QtWebsocket::QWsSocket* socket)
+{
+    // Connecting the socket signals here to exec the slots in this thread
+    QObject::connect(socket, SIGNAL(textFrameReceived(QByteArray)), this, SLOT(processMessage(QByteArray)));
     QObject::connect(socket, SIGNAL(disconnected()), this, SLOT(socketDisconnected()));
     QObject::connect(socket, SIGNAL(pong(quint64)), this, SLOT(processPong(quint64)));
-    QObject::connect(this, SIGNAL(finished()), this, SLOT(finished()), Qt::DirectConnection);
 
-    // Launch the event loop to exec the slots
-    exec();
+    socket->setCorked(true);
+    sockets_.insert(socket);
+    peers_.insert(socket, socket->peerAddress().toString().toLatin1());
+
+    // gone while being handed over, its disconnected() was missed
+    if (socket->state() == QAbstractSocket::UnconnectedState)
+    {
+        sockets_.remove(socket);
+        peers_.remove(socket);
+        connectionCount_.fetchAndAddOrdered(-1);
+        socket->deleteLater();
+        return;
+    }
+
+    std::cout << tr("connect done in thread : 0x%1, %2 connections")
+        .arg(QString::number((quintptr)QThread::currentThreadId(), 16))
+        .arg(sockets_.size())
+        .toStdString() << std::endl;
+}
+
+void SocketWorker::processMessage(QByteArray message)
+{
+    // ANY PROCESS HERE IS DONE IN THE WORKER THREAD !
+    auto socket = qobject_cast<QtWebsocket::QWsSocket*>(sender());
+    if (socket == NULL)
+    {
+        return;
+    }
+
+    // frames still buffered when the socket was closed below
+    if (socket->state() != QAbstractSocket::ConnectedState)
+    {
+        return;
+    }
+
+    // a flood is stopped before it costs any parsing; its requests can't
+    // be answered without decoding them, so rather than leave a client
+    // waiting on a requestId it is let go
+    const QByteArray& peer = peers_[socket];
+    if (!limiter_->Take(peer, peerLimit_))
+    {
+        socket->close(QtWebsocket::ClosePolicyViolated, tr("Too many requests"));
+        return;
+    }
+
+    // UTF-8 from the socket to the parser and back, the socket
+    // validated it already
+    auto request = QJsonDocument::fromJson(message).toVariant().toMap();
+
+    quint64 token = ++lastToken_;
+    requestSockets_.insert(token, socket);
+    if (!request.contains("requestId"))
+    {
+        orderedRequests_[socket].enqueue(token);
+    }
+
+    // the next frame is read without waiting for the response
+    emit newFEMPRequest(request, QString::fromLatin1(peer), [this, token](const QVariantMap& response)
+    {
+        emit responseReady(token, response);
+    });
+}
+
+void SocketWorker::sendResponse(quint64 token, QVariantMap response)
+{
+    // the socket went away in the meantime
+    auto it = requestSockets_.find(token);
+    if (it == requestSockets_.end())
+    {
+        return;
+    }
+    auto socket = it.value();
+
+    if (response.contains("requestId"))
+    {
+        requestSockets_.erase(it);
+        WriteResponse_(socket, response);
+        return;
+    }
+
+    readyResponses_.insert(token, response);
+
+    // out until the oldest one still running
+    auto& queue = orderedRequests_[socket];
+    while (!queue.isEmpty() && readyResponses_.contains(queue.head()))
+    {
+        quint64 next = queue.dequeue();
+        requestSockets_.remove(next);
+        // the queue is gone along with the socket
+        if (!WriteResponse_(socket, readyResponses_.take(next)))
+        {
+            return;
+        }
+    }
+}
+
+bool SocketWorker::WriteResponse_(QtWebsocket::QWsSocket* socket, const QVariantMap& response)
+{
+    socket->writeText(QJsonDocument::fromVariant(response).toJson());
+
+    // responses can't be dropped, a client can only be let go
+    if (socket->pendingBytes() > maxBufferedBytes_)
+    {
+        socket->abort(tr("Too much data pending"));
+        return false;
+    }
+
+    if (!flushTimer_->isActive())
+    {
+        flushTimer_->start();
+    }
+    return true;
 }
 
-void SocketThread::finished()
+void SocketWorker::sendFrames(QByteArray frames, QByteArray message)
 {
-    this->moveToThread(QCoreApplication::instance()->thread());
-    this->deleteLater();
+    // aborting removes the socket from the set, not while iterating it
+    std::vector<QtWebsocket::QWsSocket*> tooSlow;
+
+    for (auto socket : sockets_)
+    {
+        if (!IsBehind_(socket))
+        {
+            socket->writeSharedFrames(frames, message);
+            continue;
+        }
+
+        // the tick is skipped, the next one supersedes it anyway
+        if (socket->pendingBytes() > maxBufferedBytes_
+            || slowSince_[socket].elapsed() > slowTimeout_)
+        {
+            tooSlow.push_back(socket);
+        }
+    }
+
+    for (auto socket : tooSlow)
+    {
+        socket->abort(tr("Too slow"));
+    }
+
+    // the tick is over
+    flushSockets();
 }
 
-void SocketThread::processMessage(QString message)
+bool SocketWorker::IsBehind_(QtWebsocket::QWsSocket* socket)
 {
-    // ANY PROCESS HERE IS DONE IN THE SOCKET THREAD !
-//    std::cout << tr("thread 0x%1 | %2")
-//        .arg(QString::number((unsigned int)QThread::currentThreadId(), 16))
-//        .arg(QString(message)).toStdString() << std::endl;
+    bool behind = socket->pendingBytes() > maxPendingBytes_
+                  || socket->pendingMessages() > maxPendingMessages_;
 
-   auto request = QJsonDocument::fromJson(message.toLatin1()).toVariant().toMap();
-   QVariantMap response;
-   emit newFEMPRequest(request, response);
-   auto responseJSON = QJsonDocument::fromVariant(response).toJson();
-//   qDebug() << "response JSON: " << responseJSON;
-   socket->write(QString::fromLatin1(responseJSON));
+    if (!behind)
+    {
+        slowSince_.remove(socket);
+    }
+    else if (!slowSince_.contains(socket))
+    {
+        slowSince_[socket].start();
+    }
+    return behind;
 }
 
-void SocketThread::sendMessage(QString message)
+void SocketWorker::flushSockets()
 {
-    socket->write(message);
+    flushTimer_->stop();
+    for (auto socket : sockets_)
+    {
+        socket->flushFrames();
+    }
 }
 
-void SocketThread::processPong(quint64 elapsedTime)
+void SocketWorker::processPong(quint64 elapsedTime)
 {
     std::cout << tr("ping: %1 ms").arg(elapsedTime).toStdString() << std::endl;
 }
 
-void SocketThread::socketDisconnected()
+void SocketWorker::socketDisconnected()
 {
-    std::cout << tr("Client disconnected, thread finished").toStdString() << std::endl;
+    auto socket = qobject_cast<QtWebsocket::QWsSocket*>(sender());
+    if (socket == NULL || !sockets_.remove(socket))
+    {
+        return;
+    }
+
+    std::cout << tr("Client disconnected").toStdString() << std::endl;
+    connectionCount_.fetchAndAddOrdered(-1);
+    slowSince_.remove(socket);
+    peers_.remove(socket);
+
+    // responses still to come are dropped on arrival
+    for (auto token : orderedRequests_.take(socket))
+    {
+        readyResponses_.remove(token);
+    }
+    for (auto it = requestSockets_.begin(); it != requestSockets_.end();)
+    {
+        it = it.value() == socket ? requestSockets_.erase(it) : it + 1;
+    }
 
     // Prepare the socket to be deleted after last events processed
     socket->deleteLater();
+}
+
+SocketThreadPool::SocketThreadPool(RateLimiter* limiter, int threadCount, QObject* parent)
+    : QObject(parent)
+{
+    qRegisterMetaType<QtWebsocket::QWsSocket*>("QtWebsocket::QWsSocket*");
+
+    if (threadCount <= 0)
+    {
+        threadCount = std::max(QThread::idealThreadCount(), 1);
+    }
+
+    for (int i = 0; i < threadCount; i++)
+    {
+        QThread* thread = new QThread(this);
+        SocketWorker* worker = new SocketWorker(limiter);
+        worker->moveToThread(thread);
+
+        connect(this
+                , &SocketThreadPool::framesComposed
+                , worker
+                , &SocketWorker::sendFrames);
+
+        connect(worker
+                , &SocketWorker::newFEMPRequest
+                , this
+                , &SocketThreadPool::newFEMPRequest
+                , Qt::DirectConnection);
+
+        thread->start();
+        threads_.push_back(thread);
+        workers_.push_back(worker);
+    }
+}
+
+SocketThreadPool::~SocketThreadPool()
+{
+    for (size_t i = 0; i < threads_.size(); i++)
+    {
+        threads_[i]->quit();
+        threads_[i]->wait();
+        // the thread is gone, nothing else can touch the worker
+        delete workers_[i];
+    }
+}
+
+int SocketThreadPool::GetThreadCount() const
+{
+    return threads_.size();
+}
+
+void SocketThreadPool::broadcastMessage(QByteArray message)
+{
+    // the buffers are shared by every worker, not copied
+    QByteArray frames = QtWebsocket::QWsSocket::composeSharedFrames(message);
+    emit framesComposed(frames, message);
+}
+
+void SocketThreadPool::AddSocket(QtWebsocket::QWsSocket* socket)
+{
+    // least connections wins, ties go round robin
+    size_t best = nextWorker_ % workers_.size();
+    for (size_t i = 1; i < workers_.size(); i++)
+    {
+        size_t index = (nextWorker_ + i) % workers_.size();
+        if (workers_[index]->GetConnectionCount() < workers_[best]->GetConnectionCount())
+        {
+            best = index;
+        }
+    }
+    nextWorker_ = best + 1;
+
+    SocketWorker* worker = workers_[best];
+    worker->connectionCount_.fetchAndAddOrdered(1);
 
-    // finish the thread execution (that quit the event loop launched by exec)
-    quit();
+    // a socket can only change threads without a parent, the worker
+    // takes care of it from then on
+    socket->setParent(NULL);
+    socket->moveToThread(threads_[best]);
+    QMetaObject::invokeMethod(worker
+                              , "addSocket"
+                              , Qt::QueuedConnection
+                              , Q_ARG(QtWebsocket::QWsSocket*, socket));
 }
@@ -1,34 +1,117 @@
 #pragma once
 
+#include <vector>
+
 #include <QtNetwork>
 #include <QThread>
+#include <QSet>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QAtomicInt>
+#include <QQueue>
 
 #include "QWsSocket.h"
 
-class SocketThread : public QThread
+#include "FEMP.hpp"
+#include "RateLimiter.hpp"
+
+// Serves any number of sockets from the thread it lives in
+class SocketWorker : public QObject
 {
     Q_OBJECT
 
 signals:
-    void newFEMPRequest(const QVariantMap& request, QVariantMap& response);
+    void newFEMPRequest(const QVariantMap& request, const QString& peer, FEMPCallback done);
+    // emitted from whichever thread finished the request
+    void responseReady(quint64 token, QVariantMap response);
 
 public:
-    SocketThread(QtWebsocket::QWsSocket* wsSocket);
-    ~SocketThread();
+    SocketWorker(RateLimiter* limiter);
+    virtual ~SocketWorker();
+
+    // safe to call from any thread
+    int GetConnectionCount() const;
 
-    QtWebsocket::QWsSocket* socket;
-    void run();
+public slots:
+    // the socket has to be moved to the worker's thread beforehand
+    void addSocket(QtWebsocket::QWsSocket* socket);
+    // frames were composed once for every connection, message is
+    // what they carry
+    void sendFrames(QByteArray frames, QByteArray message);
 
 private slots:
-    void processMessage(QString message);
-    void sendMessage(QString message);
+    // a view into the socket's receive buffer, valid during the call
+    void processMessage(QByteArray message);
     void processPong(quint64 elapsedTime);
     void socketDisconnected();
-    void finished();
+    void flushSockets();
+    void sendResponse(quint64 token, QVariantMap response);
+
+private:
+    friend class SocketThreadPool;
+
+    // false if the socket had to be let go
+    bool WriteResponse_(QtWebsocket::QWsSocket* socket, const QVariantMap& response);
+
+    // true while the socket has more unsent data than it should
+    bool IsBehind_(QtWebsocket::QWsSocket* socket);
+
+    QSet<QtWebsocket::QWsSocket*> sockets_;
+    // sockets are corked, everything written to them goes out together
+    // at the end of a tick, or after this many ms if no tick comes
+    int flushDelay_ = 20;
+    QTimer* flushTimer_ = NULL;
+
+    // ticks are not sent to connections behind by this much,
+    // those behind for longer than slowTimeout_ ms or buffering
+    // more than maxBufferedBytes_ are disconnected
+    qint64 maxPendingBytes_ = 256 * 1024;
+    int maxPendingMessages_ = 64;
+    qint64 maxBufferedBytes_ = 4 * 1024 * 1024;
+    int slowTimeout_ = 5000;
+    QHash<QtWebsocket::QWsSocket*, QElapsedTimer> slowSince_;
+
+    // shared by all the connections of a client, whichever thread they're on
+    RateLimiter* limiter_;
+    RateLimiter::Limit peerLimit_ = {peerRequestRate, peerRequestBurst};
+    QHash<QtWebsocket::QWsSocket*, QByteArray> peers_;
+
+    // requests are answered as they finish, those with a requestId
+    // right away, those without in the order they came in
+    quint64 lastToken_ = 0;
+    QHash<quint64, QtWebsocket::QWsSocket*> requestSockets_;
+    QHash<QtWebsocket::QWsSocket*, QQueue<quint64>> orderedRequests_;
+    QHash<quint64, QVariantMap> readyResponses_;
+    // counts sockets on their way to the worker too
+    QAtomicInt connectionCount_;
+};
+
+// Fixed set of I/O threads, one per core by default, each running
+// an event loop for a worker that multiplexes many connections.
+// New connections go to the least loaded thread.
+class SocketThreadPool : public QObject
+{
+    Q_OBJECT
 
 signals:
-    void messageReceived(QString frame);
+    void newFEMPRequest(const QVariantMap& request, const QString& peer, FEMPCallback done);
+    void framesComposed(QByteArray frames, QByteArray message);
 
-private:
+public slots:
+    // delivered to every connection, framed only once for all of them
+    void broadcastMessage(QByteArray message);
 
+public:
+    SocketThreadPool(RateLimiter* limiter, int threadCount = 0, QObject* parent = NULL);
+    virtual ~SocketThreadPool();
+
+    int GetThreadCount() const;
+
+    // called from the thread the socket lives in
+    void AddSocket(QtWebsocket::QWsSocket* socket);
+
+private:
+    std::vector<QThread*> threads_;
+    std::vector<SocketWorker*> workers_;
+    unsigned nextWorker_ = 0;
 };
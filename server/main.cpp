@@ -2,6 +2,7 @@
 
 #include "MainWindow.hpp"
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QtMessageHandler>
 
 void HandleQDebugMessageOutput(QtMsgType type, const QMessageLogContext &context, const QString &msg)
@@ -50,7 +51,21 @@ int main(int argc, char **argv)
 #endif
 
     QApplication a(argc, argv);
-    MainWindow w;
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption workersOption("workers"
+                                     , "Simulation worker threads, 0 for one per core."
+                                     , "count"
+                                     , "0");
+    QCommandLineOption pinWorkersOption("pin-workers"
+                                        , "Bind each simulation worker to a core of its own.");
+    parser.addOption(workersOption);
+    parser.addOption(pinWorkersOption);
+    parser.process(a);
+
+    MainWindow w(qMax(parser.value(workersOption).toInt(), 0)
+                 , parser.isSet(pinWorkersOption));
     w.show();
 
     return a.exec();
@@ -23,6 +23,8 @@ INCLUDEPATH += \
     ../3rd/deku2d \
 
 LIBS += -L../3rd/lib
+# permessage-deflate of QtWebsocket, gzipped assets
+LIBS += -lz
 DESTDIR = ../bin
 
 CONFIG(debug, debug|release) {
@@ -49,6 +51,7 @@ SOURCES += Server.cpp \
     DebugStream.cpp \
     GameServer.cpp \
     WebSocketThread.cpp \
+    HttpThread.cpp \
     PermaStorage.cpp \
     Actor.cpp \
     Player.cpp \
@@ -56,8 +59,18 @@ SOURCES += Server.cpp \
     ../3rd/deku2d/2de_Math.cpp \
     utils.cpp \
     LevelMap.cpp \
+    RegionMap.cpp \
+    ItemLayer.cpp \
+    FlowField.cpp \
+    PathFinder.cpp \
+    FieldOfView.cpp \
     Creature.cpp \
     Item.cpp \
+    Inventory.cpp \
+    TimerWheel.cpp \
+    JobSystem.cpp \
+    AssetCache.cpp \
+    RateLimiter.cpp \
     ../3rd/deku2d/2de_Box.cpp
 
 HEADERS += Server.hpp \
@@ -65,14 +78,26 @@ HEADERS += Server.hpp \
     DebugStream.hpp \
     GameServer.hpp \
     WebSocketThread.hpp \
+    HttpThread.hpp \
+    FEMP.hpp \
     PermaStorage.hpp \
     Actor.hpp \
     Player.hpp \
     Monster.hpp \
     utils.hpp \
     LevelMap.hpp \
+    RegionMap.hpp \
+    ItemLayer.hpp \
+    FlowField.hpp \
+    PathFinder.hpp \
+    FieldOfView.hpp \
     Creature.hpp \
     Item.hpp \
+    Inventory.hpp \
+    TimerWheel.hpp \
+    JobSystem.hpp \
+    AssetCache.hpp \
+    RateLimiter.hpp \
     ../3rd/deku2d/2de_Box.h
 
 FORMS += \